@@ -18,15 +18,91 @@
 #include <algorithm>
 #include <memory>
 #include <cassert>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
 
 // we better include the iterator
 #include "btree_iterator.h"
+#include "btree_alloc.h"
+#include "btree_arena.h"
+#include "btree_gapped.h"
+#include "btree_inline.h"
+#include "btree_bloom.h"
+#include "btree_hash_index.h"
+#include "btree_counters.h"
+#include "btree_frozen.h"
+#include "btree_metrics.h"
+#include "btree_trace.h"
 
 template <typename T> class btree;
 
 template <typename T>
 std::ostream& operator<<(std::ostream& os, const btree<T>& tree);
 
+/**
+ * A snapshot of the shape and memory use of a btree, as returned by
+ * btree<T>::stats().  Levels are numbered from 0 at the root.  The
+ * per-level arrays are fixed in size so that gathering statistics never
+ * allocates; nodes deeper than the last level are counted in the last
+ * entry.
+ */
+struct btree_stats {
+	static const size_t max_levels = 64;
+
+	size_t size;                          // elements stored
+	size_t nodes;                         // nodes, counting a root held inline
+	size_t inline_size;                   // elements held in the tree object, with no node allocated
+	size_t flat_size;                     // elements in a flat sorted array, before the tree has nodes
+	size_t leaves;                        // nodes with no children
+	size_t height;                        // number of levels
+	size_t nodes_per_level[max_levels];
+	size_t leaf_depths[max_levels];       // leaves found at each level
+
+	size_t min_fill;                      // fewest elements in a node
+	size_t max_fill;                      // most elements in a node
+	double avg_fill;                      // mean elements per node over the node capacity, or a flat root's
+
+	size_t node_bytes;                    // the node store, including slots not yet used
+	size_t value_bytes_used;              // element storage in use
+	size_t value_bytes_reserved;          // element storage allocated
+	size_t child_bytes_used;              // child handle storage in use
+	size_t child_bytes_reserved;          // child handle storage allocated
+	size_t nodes_per_class[3];            // nodes at small, medium and full capacity
+	size_t capacity_bytes_saved;          // storage not reserved, against every node at full capacity
+	size_t reserve_nodes;                 // spare node storage left from reserve()
+	size_t reserve_bytes;                 // the heap held by that storage
+	size_t reserve_exhausted;             // inserts that found the reserve empty and allocated
+	size_t bloom_bytes;                   // the Bloom filter, if enabled
+
+	double bloom_bits_per_key;            // the filter's setting, or 0 without one
+	size_t bloom_checks;                  // finds that consulted the filter
+	size_t bloom_negatives;               // finds the filter answered on its own
+	size_t bloom_false_positives;         // finds the filter let through that missed
+
+	size_t hash_index_bytes;              // the hash index, if enabled
+	size_t hash_index_entries;            // elements indexed
+	size_t hash_index_updates;            // entries written, including moves as it grew
+	size_t hash_index_lookups;            // finds and inserts that consulted the index
+	size_t hash_index_stale_hints;        // lookups whose slot hint had moved
+
+	/**
+	 * Heap bytes held by the tree, excluding anything the elements
+	 * themselves allocate.
+	 */
+	size_t bytes() const { return node_bytes + value_bytes_reserved + child_bytes_reserved + reserve_bytes + bloom_bytes + hash_index_bytes; }
+
+	/**
+	 * The measured false positive rate of the Bloom filter: of the
+	 * finds for absent elements, the share it failed to reject.
+	 */
+	double bloom_fp_rate() const {
+		size_t absent = bloom_negatives + bloom_false_positives;
+		return absent ? static_cast<double>(bloom_false_positives) / absent : 0;
+	}
+};
+
 template <typename T> 
 class btree {
 	public:
@@ -48,10 +124,33 @@ class btree {
 		 * and operator==. (These are already implemented on
 		 * behalf of all built-ins: ints, doubles, strings, etc.)
 		 * 
+		 * Nodes live in an arena (see btree_arena.h) and refer to their
+		 * parent and children by 32-bit handle, and to their place
+		 * among their parent's children by a 16-bit slot.
+		 *
+		 * Until the root holds more than kInlineElems elements, or the
+		 * node size if that is less, it is kept inline in the tree
+		 * object (see btree_inline.h) and the tree allocates nothing.
+		 * Iterators into an inline root are invalidated when the tree
+		 * outgrows it and moves it to the heap, and when the tree is
+		 * moved.
+		 *
+		 * Given flatElems, the tree starts as a single sorted array,
+		 * inline while it fits and then on the heap, which is faster
+		 * than nodes to search and to walk while it is small.  The
+		 * insert that would take it past flatElems elements builds
+		 * nodes from it, each full before any of its children is made,
+		 * so the tree is as shallow as the node size allows.  Inserts
+		 * into the array invalidate iterators into it.
+		 *
 		 * @param maxNodeElems the maximum number of elements
 		 *        that can be stored in each B-Tree node
+		 * @param flatElems the most elements kept in a flat array before
+		 *        the tree moves them to nodes; 0 for nodes from the start
+		 * @throw std::invalid_argument if maxNodeElems is over 65535,
+		 *        which would overflow a node's slot
 		 */
-		btree(size_t maxNodeElems = 40) : maxNodeElems_{maxNodeElems}, head_{nullptr} { }
+		btree(size_t maxNodeElems = 40, size_t flatElems = 0);
 
 		/**
 		 * The copy constructor and  assignment operator.
@@ -72,17 +171,36 @@ class btree {
 
 		/** 
 		 * Move constructor
-		 * Creates a new B-Tree by "stealing" from original.
+		 * Creates a new B-Tree by "stealing" from original, along with
+		 * its Bloom filter.  Trace recording and metrics registration
+		 * stay with original.  Nothing is allocated, so containers of
+		 * trees move them rather than copy them when they grow.
 		 *
 		 * @param original an rvalue reference to a B-Tree object
 		 */
-		btree(btree<T>&& original) = default;
+		btree(btree<T>&& original) noexcept(std::is_nothrow_move_constructible<T>::value);
+
+		/**
+		 * Destructor
+		 * Unregisters the tree from its metrics registry, if any.
+		 */
+		~btree() { unregister_metrics(); }
 
 
 		/** 
 		 * Copy assignment
 		 * Replaces the contents of this object with a copy of rhs.
 		 *
+		 * When both trees have nodes, this tree's nodes are rewritten in
+		 * place with rhs's elements and links, so only nodes beyond this
+		 * tree's count, and nodes whose capacity differs from their
+		 * counterpart's, allocate.  Dense nodes assign over the elements
+		 * they hold; gapped ones destroy them and copy rhs's into the
+		 * same slots.  Nodes left over
+		 * are destroyed, but their place in the arena is kept.  Refreshing
+		 * a replica from a primary of much the same shape allocates
+		 * little or nothing.
+		 *
 		 * @param rhs a const lvalue reference to a B-Tree object
 		 */
 		btree<T>& operator=(const btree<T>& rhs);
@@ -92,9 +210,13 @@ class btree {
 		 * Replaces the contents of this object with the "stolen"
 		 * contents of original.
 		 *
+		 * The Bloom filter, if any, moves with the contents.  Trace
+		 * recording and metrics registration are left as they were on
+		 * both trees.
+		 *
 		 * @param rhs a const reference to a B-Tree object
 		 */
-		btree<T>& operator=(btree<T>&& rhs) = default;
+		btree<T>& operator=(btree<T>&& rhs) noexcept(std::is_nothrow_move_constructible<T>::value);
 
 		/**
 		 * Puts a breadth-first traversal of the B-Tree onto the output
@@ -119,18 +241,25 @@ class btree {
 		iterator begin();
 		iterator end();
 
-		inline const_reverse_iterator crbegin() const { return const_reverse_iterator(cend()); }
-		inline const_reverse_iterator crend() const { return const_reverse_iterator(cbegin()); }
+		const_reverse_iterator crbegin() const;
+		inline const_reverse_iterator crend() const { return const_reverse_iterator(const_iterator(start())); }
 		inline const_reverse_iterator rbegin() const { return crbegin(); }
 		inline const_reverse_iterator rend() const { return crend();}
-		inline reverse_iterator rbegin() { return reverse_iterator(end()); }
-		inline reverse_iterator rend() { return reverse_iterator(begin()); }
+		reverse_iterator rbegin();
+		inline reverse_iterator rend() { return reverse_iterator(start()); }
 
 		/**
 		 * Returns an iterator to the matching element, or whatever 
 		 * the non-const end() returns if the element could 
 		 * not be found.  
 		 *
+		 * Each thread keeps a finger on the node its last find or
+		 * insert ended at, together with the range of elements below
+		 * it.  An element inside that range is searched for from the
+		 * finger rather than the root, and one just outside it from
+		 * the nearest ancestor whose elements span it, so streams of
+		 * nearby elements skip most of the descent.
+		 *
 		 * @param elem the client element we are trying to match.  The elem,
 		 *        if an instance of a true class, relies on the operator< and
 		 *        and operator== methods to compare elem to elements already 
@@ -152,6 +281,14 @@ class btree {
 		 */
 		const_iterator find(const T& elem) const;
 
+		/**
+		 * Whether a matching element is in the btree.
+		 *
+		 * @param elem the client element we are trying to match.
+		 * @return true if and only if find would return an element
+		 */
+		inline bool contains(const T& elem) const { return find(elem) != cend(); }
+
 		/**
 		 * Operation which inserts the specified element
 		 * into the btree if a matching element isn't already
@@ -181,25 +318,229 @@ class btree {
 		 */
 		std::pair<iterator, bool> insert(const T& elem); 
 
+		/**
+		 * Sets aside everything the next n inserts could need, so that
+		 * none of them calls the allocator.  A tree still flat that n
+		 * more elements would take past its threshold moves to nodes
+		 * now.  Node slots are allocated in the arena, and spare element
+		 * and child storage is made for every size class: one small
+		 * node per insert, since each insert can make a node, and as
+		 * many of the larger classes as nodes could grow into.  Inserts
+		 * make and grow nodes by trading storage with the spares, and a
+		 * node's outgrown storage becomes a spare of its class.  The
+		 * Bloom filter and hash index, if any, are sized for the n
+		 * elements too.  Trace recording may still allocate.
+		 *
+		 * The spares are sized for the worst case, so they can hold
+		 * many times the memory the n elements end up needing; stats()
+		 * reports what is left.  Once a class runs out, inserts needing
+		 * it allocate as usual and are counted as exhausting the
+		 * reserve.  Spares are not copied with the tree.
+		 *
+		 * @param n the number of elements about to be inserted
+		 */
+		void reserve(size_t n);
+
+		/**
+		 * Starts (or, given nullptr, stops) recording the operations
+		 * made on this tree: every insert and find, and the start of
+		 * every forward or reverse traversal.  The writer is not owned
+		 * and must outlive the recording; copies of the tree are not
+		 * recorded.
+		 *
+		 * @param writer the trace to append operations to
+		 */
+		inline void trace(btree_trace::writer<T> *writer) { tracer_ = writer; }
+
+		/**
+		 * Gathers the shape and memory use of the tree in a single
+		 * pass.  The walk follows parent links instead of keeping a
+		 * stack, so it allocates nothing and is safe to call from a
+		 * metrics endpoint however deep the tree has grown.  Built with
+		 * BTREE_PATH_ITERATORS, nodes have no parent links, and the walk
+		 * visits each node as an iterator reaches its first element.
+		 *
+		 * @return the tree's statistics
+		 */
+		btree_stats stats() const;
+
+		/**
+		 * Registers the tree with a metrics registry under the given
+		 * name, replacing any earlier registration.  From then on the
+		 * tree counts its inserts, finds, hits, misses, splits and node
+		 * allocations into the registry, and the registry reads its
+		 * size, height, node count and bytes when rendering.  The
+		 * registration ends when the tree is destroyed, so the registry
+		 * must outlive it.  Copies and move-constructed trees are not
+		 * registered.
+		 *
+		 * @param registry the registry to report to
+		 * @param name the tree's label in the rendered metrics
+		 * @throw std::invalid_argument if the name is already registered
+		 */
+		void register_metrics(btree_metrics::registry &registry, const std::string &name);
+
+		/**
+		 * Ends the tree's metrics registration, if it has one.
+		 */
+		void unregister_metrics();
+
+		/**
+		 * Puts a blocked Bloom filter in front of find, built from the
+		 * elements already stored and kept up to date by insert.  Most
+		 * finds for absent elements are then answered from one cache
+		 * line of the filter without descending the tree.  When more
+		 * elements have been inserted than the filter was sized for it
+		 * is rebuilt at twice the size, keeping the false positive rate
+		 * steady.  The filter is part of the tree's value: copies get
+		 * one too.  T must be hashable by std::hash.
+		 *
+		 * @param bits_per_key the filter's size per element, from 1 to
+		 *        64; 10 gives about 1% false positives
+		 * @throw std::invalid_argument if bits_per_key is out of range
+		 */
+		void enable_bloom(double bits_per_key = 10);
+
+		/**
+		 * Removes the Bloom filter, if any.
+		 */
+		inline void disable_bloom() { bloom_.reset(); }
+
+		/**
+		 * Rebuilds the Bloom filter, if any, sized for the elements
+		 * stored now, and restarts its counts.  A filter can only
+		 * grow as elements are inserted, so call this after shrinking
+		 * the contents, for instance by assigning a smaller tree.
+		 */
+		void rebuild_bloom();
+
+		/**
+		 * Keeps a hash index from each element to its node and slot,
+		 * built from the elements already stored and kept up to date by
+		 * insert.  find, and the check insert makes for an existing
+		 * element, then take a hash lookup instead of a descent, while
+		 * iteration still walks the tree.  stats() reports the index's
+		 * memory and how much updating it has cost.  Like the Bloom
+		 * filter, copies get an index of their own.  T must be hashable
+		 * by std::hash.
+		 */
+		void enable_hash_index();
+
+		/**
+		 * Drops the hash index, if any.
+		 */
+		inline void disable_hash_index() { hashIndex_.reset(); }
+
+		/**
+		 * Copies the elements into a read-only snapshot laid out for
+		 * fast searching (see btree_frozen.h).  The tree itself is
+		 * unchanged; frozen_btree<T>::thaw() makes a mutable tree from
+		 * the snapshot again.
+		 *
+		 * @return the snapshot
+		 */
+		inline frozen_btree<T> freeze() const { return frozen_btree<T>(const_iterator(start()), cend()); }
+
 	private:
 		// The details of your implementation go here
 		struct node {
-			node(node *parent, size_t index, size_t size);
-			node(node *parent, size_t index, size_t size, const T& elem);
-			node(node *parent, size_t size, const node& original);
-
-			node *parent_;
-			size_t index_;
-			std::vector<T> values_;
-			std::vector<std::unique_ptr<node>> children_;
+			using handle = typename btree_arena<node>::handle;
+
+			node(handle parent, size_t index, size_t size);
+			node(handle parent, size_t index, size_t size, const T& elem);
+			node(handle parent, size_t index, node &&spare, const T& elem);
+
+#ifndef BTREE_PATH_ITERATORS
+			handle parent_;             // 0 at the root
+			std::uint16_t index_;       // the slot in the parent's children_
+#endif
+#ifdef BTREE_GAPPED_NODES
+			btree_gapped<T> values_;                                   // dense once full
+#else
+			btree_dense<T> values_;
+#endif
+			std::vector<handle, btree_allocator<handle>> children_;    // 0 where there is no child
 		};
 
+		using handle = typename node::handle;
+
+		static const size_t kMaxNodeElems = 65535;
+		// as many elements as fit in 128 bytes, up to 16
+		static const size_t kInlineElems = sizeof(T) <= 8 ? 16 : sizeof(T) < 128 ? 128 / sizeof(T) : 1;
+
 		size_t maxNodeElems_;
-		std::unique_ptr<node> head_;
+		size_t flatElems_;
+		std::unique_ptr<btree_arena<node>> arena_;    // null until the first insert
+		node *head_;                                  // handle 1 in arena_
+		size_t id_;
+		btree_trace::writer<T> *tracer_;
+		btree_metrics::entry *metrics_;
+		std::unique_ptr<blocked_bloom<T>> bloom_;
+		std::unique_ptr<btree_hash_index<T, node>> hashIndex_;
+		btree_inline<T, kInlineElems> small_;         // the root, while head_ is null
+		std::vector<T, btree_allocator<T>> sorted_;   // the flat array, once it outgrows small_
+
+		/**
+		 * Node storage set aside by reserve(), one list per size class
+		 * as stats() numbers them.  Each spare is a node made at its
+		 * class's capacity and never linked into the tree; inserts take
+		 * its storage.
+		 */
+		struct reserve_pool {
+			std::vector<node, btree_allocator<node>> spares[3];
+			size_t exhausted;       // inserts that found their class empty
+		};
+		std::unique_ptr<reserve_pool> reserve_;
+
+		static btree_metrics::gauges read_gauges(const void *tree);
+
+		/**
+		 * Where a thread's last find or insert on a tree ended.  Nodes
+		 * are never freed while a tree holds them, and every tree gets a
+		 * fresh id whenever its nodes are replaced, so a finger whose id
+		 * matches points into the tree.  The bounds are elements of full
+		 * nodes, which never change, and exclude the elements themselves;
+		 * null means unbounded.
+		 */
+		struct finger {
+			size_t tree;
+			node *at;
+			const T *low, *high;
+		};
 
-		std::pair<node*, size_t> lower_bound(node *cur, const T& elem) const;
+		static const size_t kFingers = 4;
+		static size_t next_id();
+		static finger& local_finger(size_t id);
+
+		std::pair<node*, size_t> first() const;
+		iterator start() const;
+		inline iterator flat_at(size_t slot) const;
+		inline const T* flat_data() const;
+		inline size_t flat_size() const;
+		inline size_t inline_capacity() const;
+		iterator match(const T& elem) const;
+		void spill();
+		void promote();
+		handle load(handle parent, size_t index, const T *sorted, size_t count);
+		std::pair<node*, size_t> seek(const T& elem) const;
+		std::pair<node*, size_t> lower_bound(node *cur, const T& elem, const T *&low, const T *&high) const;
 		inline bool valid(std::pair<node*, size_t> pair) const;
-		iterator make_node(node *parent, size_t index, std::unique_ptr<node> &ptr, const T& elem);
+		inline void count_find(bool hit) const;
+		inline bool bloom_rejects(const T& elem) const;
+		void bloom_insert(const T& elem);
+		void build_bloom(double bits_per_key, size_t room = 0);
+		void build_hash_index(size_t room = 0);
+		std::pair<node*, size_t> locate(const T& elem) const;
+		inline iterator indexed(iterator it);
+		iterator make_node(node *parent, size_t index, const T& elem);
+		inline size_t next_capacity(size_t capacity) const;
+		inline size_t size_class(size_t capacity) const;
+		node* spare(size_t capacity);
+		void grow(node *cur);
+		inline handle handle_of(const node *cur) const;
+		handle copy_node(btree_arena<node> &to, const btree_arena<node> &from, const node &original, handle parent, size_t index) const;
+		void copy_nodes(const btree<T>& original);
+		handle assign_node(const btree_arena<node> &from, const node &original, handle parent, size_t index, size_t &used);
 };
 
 template <typename T>
@@ -208,66 +549,127 @@ std::ostream& operator<<(std::ostream& os, const btree<T>& tree) {
 	auto oit = std::ostream_iterator<T>(os, " ");
 
 	if(!tree.head_){
+		std::copy(tree.flat_data(), tree.flat_data() + tree.flat_size(), oit);
 		return os;
 	}
 
 	std::queue<node*> q;
-	q.push(tree.head_.get());
+	q.push(tree.head_);
 
 	while(!q.empty()){
 		auto cur = q.front();
 		q.pop();
-		oit = std::copy(cur->values_.cbegin(), cur->values_.cend(), oit);
+		const auto &values = cur->values_;
+		for(size_t slot = values.first(); slot < values.slots(); slot = values.next(slot)){
+			*oit++ = values[slot];
+		}
 
-		for(const auto &ptr : cur->children_){
-			if(ptr) q.push(ptr.get());
+		for(auto child : cur->children_){
+			if(child) q.push(tree.arena_->at(child));
 		}
 	}
 	return os;
 }
 
 template<typename T>
-btree<T>::node::node(node *parent, size_t index, size_t size)
-	: parent_(parent), index_(index) {
-	values_.reserve(size);	
-	children_.reserve(size + 1);
+btree<T>::node::node(handle parent, size_t index, size_t size)
+#ifndef BTREE_PATH_ITERATORS
+	: parent_(parent), index_(static_cast<std::uint16_t>(index)),
+#else
+	:
+#endif
+	// a tree of nodes with no room still puts one element in each
+	values_(size ? size : 1) {
+	children_.reserve((size ? size : 1) + 1);
 }
 
 template<typename T>
-btree<T>::node::node(node *parent, size_t index, size_t size, const T& elem)
-	: node(parent, index, size) {
-	values_.push_back(elem);
-
-	children_.push_back(nullptr);
-	children_.push_back(nullptr);
+btree<T>::node::node(handle parent, size_t index, node &&spare, const T& elem)
+#ifndef BTREE_PATH_ITERATORS
+	: parent_(parent), index_(static_cast<std::uint16_t>(index)),
+#else
+	:
+#endif
+	values_(std::move(spare.values_)), children_(std::move(spare.children_)) {
+	values_.insert(values_.slots(), elem);
+	children_.resize(values_.slots() + 1);
 }
 
 template<typename T>
-btree<T>::node::node(node *parent, size_t size, const node& original)
-	: node(parent, original.index_, size) {
-
-	for(const auto &val : original.values_){
-		values_.push_back(val);
-	}
+btree<T>::node::node(handle parent, size_t index, size_t size, const T& elem)
+	: node(parent, index, size) {
+	values_.insert(values_.slots(), elem);
+	children_.resize(values_.slots() + 1);
+}
 
-	for(const auto &child : original.children_){
-		if(!child){
-			children_.push_back(nullptr);
-		}
-		else{
-			children_.emplace_back(new node(this, size, *child));
-		}
-	}
+template<typename T>
+btree<T>::btree(size_t maxNodeElems, size_t flatElems)
+	: maxNodeElems_{maxNodeElems}, flatElems_{flatElems}, head_{nullptr}, id_{next_id()}, tracer_{nullptr}, metrics_{nullptr} {
+	if(maxNodeElems > kMaxNodeElems) throw std::invalid_argument("btree: more than 65535 elements a node");
 }
 
 template<typename T>
 btree<T>::btree(const btree<T>& original)
-	: maxNodeElems_{original.maxNodeElems_}, head_{original.head_ ? new node(nullptr, maxNodeElems_, *original.head_) : nullptr } { }
+	: maxNodeElems_{original.maxNodeElems_}, flatElems_{original.flatElems_}, head_{nullptr}, id_{next_id()}, tracer_{nullptr}, metrics_{nullptr},
+	  bloom_{original.bloom_ ? new blocked_bloom<T>(*original.bloom_) : nullptr} {
+	copy_nodes(original);
+	// the index points at nodes, so the copy needs its own
+	if(original.hashIndex_) build_hash_index();
+}
+
+template<typename T>
+btree<T>::btree(btree<T>&& original) noexcept(std::is_nothrow_move_constructible<T>::value)
+	: maxNodeElems_{original.maxNodeElems_}, flatElems_{original.flatElems_}, arena_{std::move(original.arena_)}, head_{original.head_}, id_{next_id()}, tracer_{nullptr}, metrics_{nullptr},
+	  bloom_{std::move(original.bloom_)}, hashIndex_{std::move(original.hashIndex_)}, small_{std::move(original.small_)},
+	  sorted_{std::move(original.sorted_)}, reserve_{std::move(original.reserve_)} {
+	original.head_ = nullptr;
+	original.id_ = next_id();
+}
 
 template<typename T>
 btree<T>& btree<T>::operator=(const btree<T>& original) {
 	maxNodeElems_ = original.maxNodeElems_;
-	head_.reset(original.head_ ? new node(nullptr, maxNodeElems_, *original.head_) : nullptr);
+	flatElems_ = original.flatElems_;
+	size_t before = arena_ ? arena_->size() : 0;
+	if(this != &original && arena_ && original.head_){
+		size_t used = 0;
+		assign_node(*original.arena_, *original.head_, 0, 0, used);
+		arena_->truncate(used);
+		head_ = arena_->at(1);
+		small_.clear();
+		sorted_.clear();
+	}
+	else{
+		copy_nodes(original);
+		before = 0;
+	}
+	// every finger into the old nodes is stale, even where they were reused
+	id_ = next_id();
+	// spares are made for a node size, and the copy may change it
+	reserve_.reset();
+	bloom_.reset(original.bloom_ ? new blocked_bloom<T>(*original.bloom_) : nullptr);
+	hashIndex_.reset();
+	if(original.hashIndex_) build_hash_index();
+	if(metrics_ && arena_ && arena_->size() > before) metrics_->add(btree_metrics::nodes_allocated, arena_->size() - before);
+	return *this;
+}
+
+template<typename T>
+btree<T>& btree<T>::operator=(btree<T>&& rhs) noexcept(std::is_nothrow_move_constructible<T>::value) {
+	maxNodeElems_ = rhs.maxNodeElems_;
+	flatElems_ = rhs.flatElems_;
+	node *head = rhs.head_;
+	rhs.head_ = nullptr;
+	arena_ = std::move(rhs.arena_);
+	head_ = head;
+	id_ = next_id();
+	rhs.id_ = next_id();
+	bloom_ = std::move(rhs.bloom_);
+	hashIndex_ = std::move(rhs.hashIndex_);
+	small_ = std::move(rhs.small_);
+	sorted_ = std::move(rhs.sorted_);
+	rhs.sorted_.clear();
+	reserve_ = std::move(rhs.reserve_);
 	return *this;
 }
 
@@ -275,12 +677,8 @@ template<typename T>
 auto btree<T>::cbegin() const
 	-> const_iterator { 
 
-	if(head_) {
-		node* cur; 
-		for(cur = head_.get(); cur->children_.at(0); cur = cur->children_.at(0).get());
-		return {cur, 0};
-	}
-	return {nullptr, 0}; 
+	if(tracer_) tracer_->scan();
+	return start();
 }
 
 template<typename T>
@@ -288,21 +686,17 @@ auto btree<T>::cend() const
 	-> const_iterator { 
 
 	if(head_) {
-		return {head_.get(), head_->values_.size()};
+		return {arena_.get(), head_, head_->values_.slots()};
 	}
-	return {nullptr, 0}; 
+	return flat_at(flat_size());
 }
 
 template<typename T>
 auto btree<T>::begin()
 	-> iterator { 
 
-	if(head_) {
-		node* cur; 
-		for(cur = head_.get(); cur->children_.at(0); cur = cur->children_.at(0).get());
-		return {cur, 0};
-	}
-	return {nullptr, 0}; 
+	if(tracer_) tracer_->scan();
+	return start();
 }
 
 template<typename T>
@@ -310,92 +704,748 @@ auto btree<T>::end()
 	-> iterator { 
 
 	if(head_) {
-		return {head_.get(), head_->values_.size()};
+		return {arena_.get(), head_, head_->values_.slots()};
 	}
-	return {nullptr, 0}; 
+	return flat_at(flat_size());
+}
+
+template<typename T>
+auto btree<T>::crbegin() const
+	-> const_reverse_iterator {
+
+	if(tracer_) tracer_->reverse_scan();
+	return const_reverse_iterator(cend());
+}
+
+template<typename T>
+auto btree<T>::rbegin()
+	-> reverse_iterator {
+
+	if(tracer_) tracer_->reverse_scan();
+	return reverse_iterator(end());
 }
 
 template<typename T>
 auto btree<T>::find(const T& elem) 
 	-> iterator {
 
-	if(head_ == nullptr){
+	if(tracer_) tracer_->find(elem);
+	BTREE_COUNT(finds);
+	BTREE_COUNT_VISITS(find_visits);
+	if(bloom_rejects(elem)){
+		count_find(false);
 		return end();
 	}
-	auto lower = lower_bound(head_.get(), elem);
-	return valid(lower) && lower.first->values_.at(lower.second) == elem ? (lower) : end();
+	iterator found = match(elem);
+	bool hit = found != end();
+	if(bloom_ && !hit) bloom_->false_positive();
+	count_find(hit);
+	return found;
 }
 
 template<typename T>
 auto btree<T>::find(const T& elem) const 
 	-> const_iterator {
 
-	if(head_ == nullptr){
+	if(tracer_) tracer_->find(elem);
+	BTREE_COUNT(finds);
+	BTREE_COUNT_VISITS(find_visits);
+	if(bloom_rejects(elem)){
+		count_find(false);
 		return cend();
 	}
-	auto lower = lower_bound(head_.get(), elem);
-	return valid(lower) && lower.first->values_.at(lower.second) == elem ? (lower) : cend();
+	const_iterator found = match(elem);
+	bool hit = found != cend();
+	if(bloom_ && !hit) bloom_->false_positive();
+	count_find(hit);
+	return found;
 }
 
 template<typename T>
 auto btree<T>::insert(const T& elem) 
 	-> std::pair<iterator, bool> {
 
+	if(tracer_) tracer_->insert(elem);
+	BTREE_COUNT(inserts);
+	BTREE_COUNT_VISITS(insert_visits);
+	if(metrics_) metrics_->add(btree_metrics::inserts);
+	if(head_ == nullptr && !arena_){
+		size_t size = flat_size();
+		size_t slot = std::lower_bound(flat_data(), flat_data() + size, elem) - flat_data();
+		if(slot < size && flat_data()[slot] == elem){
+			return std::make_pair(flat_at(slot), false);
+		}
+		if(sorted_.empty() && size < inline_capacity()){
+			bloom_insert(elem);
+			small_.insert(slot, elem);
+			return std::make_pair(flat_at(slot), true);
+		}
+		if(size < flatElems_){
+			bloom_insert(elem);
+			if(sorted_.empty()){
+				// the array outgrows the tree object
+				if(sorted_.capacity() < 2 * size) sorted_.reserve(2 * size);
+				sorted_.insert(sorted_.end(), small_.data(), small_.data() + size);
+				small_.clear();
+			}
+			sorted_.insert(sorted_.begin() + slot, elem);
+			return std::make_pair(flat_at(slot), true);
+		}
+		if(size == 0) arena_.reset(new btree_arena<node>());
+		else if(flatElems_) promote();
+		else spill();
+	}
 	if(head_ == nullptr){
-		return std::make_pair(make_node(nullptr, 0, head_, elem), true);
+		bloom_insert(elem);
+		return std::make_pair(indexed(make_node(nullptr, 0, elem)), true);
+	}
+	if(hashIndex_){
+		auto found = hashIndex_->find(elem);
+		if(found.first) return std::make_pair(iterator(arena_.get(), found), false);
 	}
 
-	auto lower = lower_bound(head_.get(), elem);
+	auto lower = seek(elem);
 	auto &values = lower.first->values_; 
 
 	if(valid(lower) && values.at(lower.second) == elem){
-		return std::make_pair(iterator(lower), false);
+		return std::make_pair(iterator(arena_.get(), lower), false);
 	}
+	bloom_insert(elem);
 
 	if(values.size() < maxNodeElems_){
-		values.push_back(elem);
-		auto it = values.rbegin() + 1;
-		for(; it < values.rend(); ++it){
-			auto prev = it - 1;
-			if(*prev < *it) {
-				std::iter_swap(prev, it);
-			}
-			else {
-				break;
+		if(values.size() == values.capacity()) grow(lower.first);
+		size_t slot = values.insert(lower.second, elem);
+		// a child slot either side of every slot: a dense node gains one
+		// with each element, a gapped one has them all from the first
+		lower.first->children_.resize(values.slots() + 1);
+		return std::make_pair(indexed(iterator(arena_.get(), lower.first, slot)), true);
+	}
+
+	return std::make_pair(indexed(make_node(lower.first, lower.second, elem)), true);
+}
+
+template<typename T>
+btree_stats btree<T>::stats() const {
+	btree_stats st{};
+	// a tree of nodes with no room still puts one element in each
+	size_t full = maxNodeElems_ ? maxNodeElems_ : 1;
+	st.min_fill = head_ || flat_size() ? full : 0;
+
+	auto visit = [this, &st](const node *cur, size_t depth) {
+		size_t level = std::min(depth, btree_stats::max_levels - 1);
+		size_t elems = cur->values_.size();
+
+		++st.nodes;
+		++st.nodes_per_level[level];
+		st.height = std::max(st.height, depth + 1);
+		st.size += elems;
+		st.min_fill = std::min(st.min_fill, elems);
+		st.max_fill = std::max(st.max_fill, elems);
+
+		st.value_bytes_used += elems * sizeof(T);
+		st.value_bytes_reserved += cur->values_.bytes();
+		st.child_bytes_used += (elems + 1) * sizeof(handle);
+		st.child_bytes_reserved += cur->children_.capacity() * sizeof(handle);
+
+		size_t capacity = cur->values_.capacity();
+		++st.nodes_per_class[size_class(capacity)];
+		if(capacity < maxNodeElems_) st.capacity_bytes_saved += (maxNodeElems_ - capacity) * (sizeof(T) + sizeof(handle));
+
+		bool leaf = std::none_of(cur->children_.cbegin(), cur->children_.cend(),
+				[](handle child) { return child != 0; });
+		if(leaf){
+			++st.leaves;
+			++st.leaf_depths[level];
+		}
+	};
+
+	if(!head_ && flat_size()){
+		// a root held inline, or a flat array, is a single leaf, and
+		// only the array is on the heap
+		st.nodes = st.leaves = st.height = 1;
+		st.nodes_per_level[0] = st.leaf_depths[0] = 1;
+		st.size = st.min_fill = st.max_fill = flat_size();
+		st.inline_size = small_.size();
+		st.flat_size = sorted_.size();
+		st.value_bytes_used = flat_size() * sizeof(T);
+		st.value_bytes_reserved = sorted_.capacity() * sizeof(T);
+		// its capacity is what it holds before it moves to nodes
+		full = std::max(flatElems_, inline_capacity());
+	}
+
+#ifdef BTREE_PATH_ITERATORS
+	if(head_){
+		for(const_iterator it(arena_.get(), first()); it != cend(); ++it){
+			if(it.index_ == it.cur_->values_.first()) visit(it.cur_, it.depth());
+		}
+	}
+#else
+	const node *cur = head_;
+	size_t depth = 0, next = 0;
+	if(cur) visit(cur, depth);
+
+	while(cur){
+		const auto &children = cur->children_;
+		while(next < children.size() && !children[next]) ++next;
+
+		if(next < children.size()){
+			cur = arena_->at(children[next]);
+			visit(cur, ++depth);
+			next = 0;
+		}
+		else{
+			next = cur->index_ + 1;
+			cur = arena_->at(cur->parent_);
+			--depth;
+		}
+	}
+#endif
+
+	if(arena_) st.node_bytes = sizeof(btree_arena<node>) + arena_->bytes();
+	if(reserve_){
+		st.reserve_bytes = sizeof(reserve_pool);
+		for(const auto &spares : reserve_->spares){
+			st.reserve_nodes += spares.size();
+			st.reserve_bytes += spares.capacity() * sizeof(node);
+			for(const node &spare : spares){
+				st.reserve_bytes += spare.values_.bytes() + spare.children_.capacity() * sizeof(handle);
 			}
 		}
-		lower.first->children_.push_back(nullptr);
+		st.reserve_exhausted = reserve_->exhausted;
+	}
+	if(bloom_){
+		st.bloom_bytes = sizeof(blocked_bloom<T>) + bloom_->bytes();
+		st.bloom_bits_per_key = bloom_->bits_per_key();
+		st.bloom_checks = bloom_->checks();
+		st.bloom_negatives = bloom_->negatives();
+		st.bloom_false_positives = bloom_->false_positives();
+	}
+	if(hashIndex_){
+		st.hash_index_bytes = sizeof(btree_hash_index<T, node>) + hashIndex_->bytes();
+		st.hash_index_entries = hashIndex_->size();
+		st.hash_index_updates = hashIndex_->updates();
+		st.hash_index_lookups = hashIndex_->lookups();
+		st.hash_index_stale_hints = hashIndex_->stale_hints();
+	}
+	st.avg_fill = st.nodes ? static_cast<double>(st.size) / (st.nodes * full) : 0;
+	return st;
+}
 
-		return std::make_pair(iterator(lower.first, values.rend() - it), true);
+template<typename T>
+auto btree<T>::first() const
+	-> std::pair<node*, size_t> {
+
+	if(head_) {
+		node* cur; 
+		for(cur = head_; cur->children_.at(0); cur = arena_->at(cur->children_.at(0)));
+		return {cur, cur->values_.first()};
 	}
+	return {nullptr, 0}; 
+}
+
+template<typename T>
+auto btree<T>::start() const
+	-> iterator {
+
+	return head_ ? iterator(arena_.get(), first()) : flat_at(0);
+}
+
+template<typename T>
+inline auto btree<T>::flat_at(size_t slot) const
+	-> iterator {
+
+	// iterators hand out mutable elements whatever the constness of
+	// the tree, as they do for elements in nodes
+	return iterator(const_cast<T*>(flat_data()), slot);
+}
+
+template<typename T>
+inline const T* btree<T>::flat_data() const {
+	return sorted_.empty() ? small_.data() : sorted_.data();
+}
+
+template<typename T>
+inline size_t btree<T>::flat_size() const {
+	return sorted_.empty() ? small_.size() : sorted_.size();
+}
+
+template<typename T>
+inline size_t btree<T>::inline_capacity() const {
+	// an inline root is never bigger than the node it stands for, nor
+	// than the flat array it starts
+	size_t limit = flatElems_ ? flatElems_ : maxNodeElems_;
+	return kInlineElems < limit ? kInlineElems : limit;
+}
 
-	return std::make_pair(make_node(lower.first, lower.second, lower.first->children_.at(lower.second), elem), true);
+template<typename T>
+auto btree<T>::match(const T& elem) const
+	-> iterator {
+
+	if(!head_){
+		const T *data = flat_data();
+		size_t size = flat_size();
+		size_t slot = std::lower_bound(data, data + size, elem) - data;
+		return flat_at(slot < size && data[slot] == elem ? slot : size);
+	}
+	auto lower = locate(elem);
+	bool hit = valid(lower) && lower.first->values_.at(lower.second) == elem;
+	return iterator(arena_.get(), hit ? lower : std::make_pair(head_, head_->values_.slots()));
+}
+
+template<typename T>
+void btree<T>::spill() {
+	// the inline root moves to the heap as a node with room for one more
+	arena_.reset(new btree_arena<node>());
+	handle made = arena_->make(0, 0, next_capacity(small_.size()));
+	BTREE_COUNT(node_allocations);
+	head_ = arena_->at(made);
+	for(size_t slot = 0; slot < small_.size(); ++slot){
+		head_->values_.insert(head_->values_.slots(), small_[slot]);
+	}
+	head_->children_.resize(head_->values_.slots() + 1);
+	small_.clear();
+	if(metrics_) metrics_->add(btree_metrics::nodes_allocated);
+	if(hashIndex_) build_hash_index();
+}
+
+template<typename T>
+void btree<T>::promote() {
+	std::vector<T, btree_allocator<T>> sorted(std::move(sorted_));
+	if(sorted.empty()) sorted.assign(small_.data(), small_.data() + small_.size());
+	small_.clear();
+	sorted_.clear();
+	arena_.reset(new btree_arena<node>());
+	load(0, 0, sorted.data(), sorted.size());
+	head_ = arena_->at(1);
+	if(hashIndex_) build_hash_index();
 }
 
 template<typename T>
-auto btree<T>::lower_bound(node *cur, const T& elem) const 
+auto btree<T>::load(handle parent, size_t index, const T *sorted, size_t count)
+	-> handle {
+
+	if(count == 0) return 0;
+	// a tree of nodes with no room still puts one element in each
+	size_t full = maxNodeElems_ ? maxNodeElems_ : 1;
+	handle made = arena_->make(parent, index, count < full ? next_capacity(count - 1) : full);
+	BTREE_COUNT(node_allocations);
+	if(metrics_) metrics_->add(btree_metrics::nodes_allocated);
+	node *cur = arena_->at(made);
+	if(count <= full){
+		for(size_t i = 0; i < count; ++i) cur->values_.insert(cur->values_.slots(), sorted[i]);
+		cur->children_.resize(cur->values_.slots() + 1);
+		return made;
+	}
+
+	// as frozen_btree<T>::thaw does: full separators here, and below
+	// them the smallest full subtrees that leave room for the rest,
+	// from the left, so only the rightmost are partial
+	size_t rest = count - full, child = full;
+	while(child * (full + 1) < rest) child = child * (full + 1) + full;
+
+	size_t pos = 0, left = rest;
+	for(size_t i = 0; i < full; ++i){
+		size_t gap = std::min(child, left);
+		pos += gap;
+		left -= gap;
+		cur->values_.insert(cur->values_.slots(), sorted[pos++]);
+	}
+	cur->children_.resize(cur->values_.slots() + 1);
+	pos = 0;
+	left = rest;
+	for(size_t i = 0; i <= full; ++i){
+		size_t gap = std::min(child, left);
+		cur->children_[i] = load(made, i, sorted + pos, gap);
+		pos += gap + 1;
+		left -= gap;
+	}
+	return made;
+}
+
+template<typename T>
+auto btree<T>::seek(const T& elem) const
 	-> std::pair<node*, size_t> {
 
+	finger &f = local_finger(id_);
+	node *start = head_;
+	const T *low = nullptr, *high = nullptr;
+
+	if(f.tree == id_){
+		if((!f.low || *f.low < elem) && (!f.high || elem < *f.high)){
+			start = f.at;
+			low = f.low;
+			high = f.high;
+		}
+		// without parent links, an element outside the finger's range
+		// is searched for from the root
+#ifndef BTREE_PATH_ITERATORS
+		else{
+			// full nodes, which include every ancestor, never change, so
+			// their first and last elements bound part of their range
+			for(node *cur = f.at; cur; cur = arena_->at(cur->parent_)){
+				const auto &values = cur->values_;
+				if(values.size() == maxNodeElems_ && !(elem < values.front()) && !(values.back() < elem)){
+					start = cur;
+					low = &values.front();
+					high = &values.back();
+					break;
+				}
+			}
+		}
+#endif
+	}
+
+	auto lower = lower_bound(start, elem, low, high);
+	f = {id_, lower.first, low, high};
+	return lower;
+}
+
+template<typename T>
+auto btree<T>::lower_bound(node *cur, const T& elem, const T *&low, const T *&high) const 
+	-> std::pair<node*, size_t> {
+
+	BTREE_COUNT(node_visits);
 	const auto &values = cur->values_;
-	auto lower = std::lower_bound(values.begin(), values.end(), elem);
-	int index = lower - values.begin();
-	if(cur->children_.at(index) == nullptr || (lower != values.end() && *lower == elem)) {
+	size_t index = values.lower_bound(elem, [](const T& a, const T& b) {
+		BTREE_COUNT(comparisons);
+		return a < b;
+	});
+	bool inside = index < values.slots();
+	if(inside) BTREE_COUNT(comparisons);
+	handle child = cur->children_.at(index);
+	if(!child || (inside && values[index] == elem)) {
 		return std::make_pair(cur, index);
 	}
-	return lower_bound(cur->children_.at(index).get(), elem);
+	// only full nodes have children, and they have no gaps
+	if(index > 0) low = &values[index - 1];
+	if(inside) high = &values[index];
+	return lower_bound(arena_->at(child), elem, low, high);
+}
+
+template<typename T>
+size_t btree<T>::next_id() {
+	static std::atomic<size_t> next{1};
+	return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename T>
+auto btree<T>::local_finger(size_t id)
+	-> finger& {
+
+	thread_local finger fingers[kFingers] = {};
+	return fingers[id % kFingers];
 }
 
 template<typename T>
 inline bool btree<T>::valid(std::pair<node*, size_t> pair) const {
-	return pair.second < pair.first->values_.size();
+	return pair.second < pair.first->values_.slots();
+}
+
+template<typename T>
+auto btree<T>::make_node(node *parent, size_t index, const T& elem) 
+	-> iterator {
+
+	handle made;
+	if(node *storage = spare(next_capacity(0))){
+		made = arena_->make(parent ? handle_of(parent) : 0, index, std::move(*storage), elem);
+		reserve_->spares[size_class(next_capacity(0))].pop_back();
+	}
+	else{
+		made = arena_->make(parent ? handle_of(parent) : 0, index, next_capacity(0), elem);
+	}
+	BTREE_COUNT(node_allocations);
+	if(parent) parent->children_.at(index) = made;
+	else head_ = arena_->at(made);
+	if(metrics_){
+		metrics_->add(btree_metrics::nodes_allocated);
+		if(parent) metrics_->add(btree_metrics::splits);
+	}
+	return iterator(arena_.get(), arena_->at(made), 0);
+}
+
+template<typename T>
+inline size_t btree<T>::next_capacity(size_t capacity) const {
+	// nodes start at an eighth of the full capacity and grow to half
+	// and then all of it, so the many leaves holding a few elements
+	// reserve room for few; below four elements a class saves less
+	// than growing into the next one costs
+	size_t small = std::max<size_t>((maxNodeElems_ + 7) / 8, 4), medium = (maxNodeElems_ + 1) / 2;
+	if(capacity < small) return std::min(small, maxNodeElems_);
+	if(capacity < medium) return medium;
+	return maxNodeElems_;
+}
+
+template<typename T>
+inline size_t btree<T>::size_class(size_t capacity) const {
+	return capacity >= maxNodeElems_ ? 2 : capacity <= next_capacity(0) ? 0 : 1;
+}
+
+template<typename T>
+auto btree<T>::spare(size_t capacity)
+	-> node* {
+
+	if(!reserve_) return nullptr;
+	auto &spares = reserve_->spares[size_class(capacity)];
+	if(spares.empty()){
+		++reserve_->exhausted;
+		return nullptr;
+	}
+	return &spares.back();
+}
+
+template<typename T>
+void btree<T>::grow(node *cur) {
+	size_t capacity = next_capacity(cur->values_.capacity());
+	node *storage = spare(capacity);
+	if(!storage){
+		cur->values_.reserve(capacity);
+		cur->children_.reserve(capacity + 1);
+		return;
+	}
+
+	// trade storage with the spare, which takes the outgrown storage,
+	// emptied, to the spares of the smaller class; the spare leaves its
+	// list first, as the two classes may be the same.  A node still
+	// growing has no children, so its child slots need no copying
+	node traded(std::move(*storage));
+	reserve_->spares[size_class(capacity)].pop_back();
+	cur->values_.move_to(traded.values_);
+	cur->values_.swap(traded.values_);
+	cur->children_.swap(traded.children_);
+	traded.children_.clear();
+	reserve_->spares[size_class(traded.values_.capacity())].push_back(std::move(traded));
+}
+
+template<typename T>
+void btree<T>::reserve(size_t n) {
+	size_t size = stats().size;
+	if(bloom_ && bloom_->capacity() < size + n) build_bloom(bloom_->bits_per_key(), size + n);
+
+	if(!head_ && !arena_){
+		// a flat tree that stays flat only needs room in its array, as
+		// much as leaving the tree object would ask for
+		size_t limit = flatElems_ ? flatElems_ : inline_capacity();
+		if(size + n <= limit){
+			if(size + n > inline_capacity()) sorted_.reserve(std::max(size + n, 2 * inline_capacity()));
+			return;
+		}
+		if(size == 0) arena_.reset(new btree_arena<node>());
+		else if(flatElems_) promote();
+		else spill();
+	}
+	// after any move to nodes, which rebuilds the index at its size
+	if(hashIndex_ && hashIndex_->capacity() < size + n) build_hash_index(size + n);
+	arena_->reserve(arena_->size() + n);
+
+	// every insert can make a small node; only a node that has filled
+	// its class grows, and none grows into a class twice, so growth
+	// into a class is bounded by the nodes below it now and by the
+	// inserts it takes to fill one from the class below
+	btree_stats st = stats();
+	size_t small = next_capacity(0), medium = next_capacity(small);
+	size_t capacities[3] = {small, medium, maxNodeElems_};
+	size_t wanted[3] = {};
+	wanted[size_class(small)] = n;
+	if(small < maxNodeElems_){
+		size_t below = st.nodes_per_class[0];
+		if(medium < maxNodeElems_){
+			wanted[1] = std::min(n, below + n / small);
+			below += st.nodes_per_class[1];
+			wanted[2] = std::min(n, below + n / medium);
+		}
+		else{
+			wanted[2] = std::min(n, below + n / small);
+		}
+	}
+
+	if(!reserve_){
+		reserve_.reset(new reserve_pool());
+		reserve_->exhausted = 0;
+	}
+	// outgrown storage comes back as spares, so any class may hold
+	// all of them
+	size_t total = wanted[0] + wanted[1] + wanted[2];
+	for(size_t c = 0; c < 3; ++c){
+		auto &spares = reserve_->spares[c];
+		spares.reserve(spares.size() + total);
+		while(spares.size() < wanted[c]) spares.emplace_back(0, 0, capacities[c]);
+	}
+}
+
+template<typename T>
+inline auto btree<T>::handle_of(const node *cur) const
+	-> handle {
+
+#ifdef BTREE_PATH_ITERATORS
+	// nothing links back to a parent, so no handle is needed
+	return 0;
+#else
+	// nodes do not keep their own handle; their parent has it
+	return cur->parent_ ? arena_->at(cur->parent_)->children_[cur->index_] : 1;
+#endif
+}
+
+template<typename T>
+auto btree<T>::copy_node(btree_arena<node> &to, const btree_arena<node> &from, const node &original, handle parent, size_t index) const
+	-> handle {
+
+	handle made = to.make(parent, index, original.values_.capacity());
+	BTREE_COUNT(node_allocations);
+	node *copy = to.at(made);
+	copy->values_.copy(original.values_);
+	copy->children_.resize(copy->values_.slots() + 1);
+	for(size_t i = 0; i < original.children_.size(); ++i){
+		handle child = original.children_[i];
+		if(child) copy->children_[i] = copy_node(to, from, *from.at(child), made, i);
+	}
+	return made;
+}
+
+template<typename T>
+auto btree<T>::assign_node(const btree_arena<node> &from, const node &original, handle parent, size_t index, size_t &used)
+	-> handle {
+
+	// nodes are rewritten in the order copy_node makes them, so the
+	// handles come out the same as in a fresh copy
+	handle made;
+	if(used < arena_->size()){
+		made = static_cast<handle>(++used);
+		node *cur = arena_->at(made);
+#ifndef BTREE_PATH_ITERATORS
+		cur->parent_ = parent;
+		cur->index_ = static_cast<std::uint16_t>(index);
+#endif
+		cur->values_.assign(original.values_);
+	}
+	else{
+		made = arena_->make(parent, index, original.values_.capacity());
+		BTREE_COUNT(node_allocations);
+		++used;
+		arena_->at(made)->values_.copy(original.values_);
+	}
+	node *cur = arena_->at(made);
+	cur->children_.assign(cur->values_.slots() + 1, 0);
+	for(size_t i = 0; i < original.children_.size(); ++i){
+		handle child = original.children_[i];
+		if(child) cur->children_[i] = assign_node(from, *from.at(child), made, i, used);
+	}
+	return made;
+}
+
+template<typename T>
+void btree<T>::copy_nodes(const btree<T>& original) {
+	// built aside first, so assigning a tree to itself copies it intact
+	std::unique_ptr<btree_arena<node>> nodes;
+	if(original.head_){
+		nodes.reset(new btree_arena<node>());
+		copy_node(*nodes, *original.arena_, *original.head_, 0, 0);
+	}
+	arena_ = std::move(nodes);
+	head_ = arena_ ? arena_->at(1) : nullptr;
+	small_ = original.small_;
+	sorted_ = original.sorted_;
+}
+
+template<typename T>
+inline void btree<T>::count_find(bool hit) const {
+	if(metrics_){
+		metrics_->add(btree_metrics::finds);
+		metrics_->add(hit ? btree_metrics::hits : btree_metrics::misses);
+	}
+}
+
+template<typename T>
+void btree<T>::register_metrics(btree_metrics::registry &registry, const std::string &name) {
+	btree_metrics::entry *entry = registry.add(name, this, &btree<T>::read_gauges);
+	unregister_metrics();
+	metrics_ = entry;
+}
+
+template<typename T>
+void btree<T>::unregister_metrics() {
+	if(metrics_){
+		metrics_->owner().remove(metrics_);
+		metrics_ = nullptr;
+	}
+}
+
+template<typename T>
+btree_metrics::gauges btree<T>::read_gauges(const void *tree) {
+	btree_stats st = static_cast<const btree<T>*>(tree)->stats();
+	return {st.size, st.height, st.nodes, st.bytes()};
+}
+
+template<typename T>
+void btree<T>::enable_bloom(double bits_per_key) {
+	static_assert(btree_hashable<T>::value, "a btree's Bloom filter needs std::hash<T>");
+	build_bloom(bits_per_key);
+}
+
+template<typename T>
+void btree<T>::rebuild_bloom() {
+	if(bloom_) build_bloom(bloom_->bits_per_key());
+}
+
+template<typename T>
+void btree<T>::build_bloom(double bits_per_key, size_t room) {
+	size_t size = 0;
+	for(const_iterator it = start(); it != cend(); ++it) ++size;
+
+	// leave room to double before the next rebuild
+	std::unique_ptr<blocked_bloom<T>> filter(new blocked_bloom<T>(std::max(2 * size, room), bits_per_key));
+	for(const_iterator it = start(); it != cend(); ++it) filter->add(*it);
+	bloom_ = std::move(filter);
+}
+
+template<typename T>
+inline bool btree<T>::bloom_rejects(const T& elem) const {
+	return bloom_ && !bloom_->may_contain(elem);
+}
+
+template<typename T>
+void btree<T>::bloom_insert(const T& elem) {
+	if(!bloom_) return;
+	if(bloom_->overfull()){
+		build_bloom(bloom_->bits_per_key());
+	}
+	bloom_->add(elem);
+}
+
+template<typename T>
+void btree<T>::enable_hash_index() {
+	static_assert(btree_hashable<T>::value, "a btree's hash index needs std::hash<T>");
+	build_hash_index();
+}
+
+template<typename T>
+void btree<T>::build_hash_index(size_t room) {
+	// elements held inline are searched directly, so only nodes are indexed
+	size_t size = 0;
+	if(head_) for(const_iterator it = start(); it != cend(); ++it) ++size;
+
+	std::unique_ptr<btree_hash_index<T, node>> index(new btree_hash_index<T, node>(std::max(size, room)));
+	if(head_) for(const_iterator it = start(); it != cend(); ++it) index->add(*it, it.cur_, it.index_);
+	hashIndex_ = std::move(index);
+}
+
+template<typename T>
+auto btree<T>::locate(const T& elem) const
+	-> std::pair<node*, size_t> {
+
+	if(hashIndex_){
+		auto found = hashIndex_->find(elem);
+		// an element missing from the index is missing from the tree
+		return found.first ? found : std::make_pair(head_, head_->values_.slots());
+	}
+	return seek(elem);
 }
 
 template<typename T>
-auto btree<T>::make_node(node *parent, size_t index, std::unique_ptr<node> &ptr, const T& elem) 
+inline auto btree<T>::indexed(iterator it)
 	-> iterator {
 
-	ptr.reset(new node(parent, index, maxNodeElems_, elem));
-	return iterator(head_.get(), 0);
+	if(hashIndex_) hashIndex_->add(*it, it.cur_, it.index_);
+	return it;
 }
 
 #endif
@@ -0,0 +1,137 @@
+/**
+ * Allocation hooks for the B-Tree.
+ *
+ * Every allocation the tree makes, for its nodes and for the element and
+ * child storage inside them, goes through btree_alloc::allocate and
+ * btree_alloc::deallocate; containers inside a node use btree_allocator,
+ * which forwards to them.  Normally these are the global operator new and
+ * delete and nothing more.
+ *
+ * Building with BTREE_ALLOC_STATS defined turns on counting: the number
+ * of allocations and deallocations, bytes allocated, live bytes and the
+ * peak of live bytes, all process-wide.  Comparing snapshot()s taken
+ * around an operation gives its allocations and bytes, which is how the
+ * benchmark reports allocations per insert and per copy.
+ */
+
+#ifndef BTREE_ALLOC_H
+#define BTREE_ALLOC_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+struct btree_alloc_stats {
+	std::uint64_t allocations;      // calls to allocate
+	std::uint64_t deallocations;    // calls to deallocate
+	std::uint64_t bytes_allocated;  // bytes requested by those allocations
+	std::uint64_t live_bytes;       // bytes allocated and not yet freed
+	std::uint64_t peak_bytes;       // the most live bytes seen since the last reset
+};
+
+namespace btree_alloc {
+
+namespace detail {
+
+struct counters {
+	std::atomic<std::uint64_t> allocations, deallocations, bytes_allocated, live_bytes, peak_bytes;
+
+	counters() : allocations{0}, deallocations{0}, bytes_allocated{0}, live_bytes{0}, peak_bytes{0} { }
+};
+
+inline counters& global() {
+	static counters c;
+	return c;
+}
+
+}
+
+/**
+ * Whether this build counts allocations at all.
+ */
+#ifdef BTREE_ALLOC_STATS
+const bool counting = true;
+#else
+const bool counting = false;
+#endif
+
+inline void* allocate(std::size_t bytes) {
+	void *ptr = ::operator new(bytes);
+	if(counting){
+		detail::counters &c = detail::global();
+		c.allocations.fetch_add(1, std::memory_order_relaxed);
+		c.bytes_allocated.fetch_add(bytes, std::memory_order_relaxed);
+		std::uint64_t live = c.live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+		std::uint64_t peak = c.peak_bytes.load(std::memory_order_relaxed);
+		while(live > peak && !c.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+	}
+	return ptr;
+}
+
+inline void deallocate(void *ptr, std::size_t bytes) noexcept {
+	if(!ptr) return;
+	if(counting){
+		detail::counters &c = detail::global();
+		c.deallocations.fetch_add(1, std::memory_order_relaxed);
+		c.live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+	}
+	::operator delete(ptr);
+}
+
+/**
+ * The counts so far; all zero unless built with BTREE_ALLOC_STATS.
+ */
+inline btree_alloc_stats snapshot() {
+	const detail::counters &c = detail::global();
+	return {c.allocations.load(std::memory_order_relaxed),
+		c.deallocations.load(std::memory_order_relaxed),
+		c.bytes_allocated.load(std::memory_order_relaxed),
+		c.live_bytes.load(std::memory_order_relaxed),
+		c.peak_bytes.load(std::memory_order_relaxed)};
+}
+
+/**
+ * Zeroes the counts and restarts the peak from the current live bytes.
+ * Live bytes are kept, since memory allocated earlier is still to be
+ * freed.
+ */
+inline void reset() {
+	detail::counters &c = detail::global();
+	c.allocations.store(0, std::memory_order_relaxed);
+	c.deallocations.store(0, std::memory_order_relaxed);
+	c.bytes_allocated.store(0, std::memory_order_relaxed);
+	c.peak_bytes.store(c.live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+}
+
+/**
+ * A standard allocator that routes through btree_alloc.
+ */
+template <typename U>
+class btree_allocator {
+	public:
+		using value_type = U;
+
+		btree_allocator() noexcept = default;
+
+		template <typename V>
+		btree_allocator(const btree_allocator<V>&) noexcept { }
+
+		U* allocate(std::size_t n) {
+			return static_cast<U*>(btree_alloc::allocate(n * sizeof(U)));
+		}
+
+		void deallocate(U *ptr, std::size_t n) noexcept {
+			btree_alloc::deallocate(ptr, n * sizeof(U));
+		}
+
+		template <typename V>
+		bool operator==(const btree_allocator<V>&) const noexcept { return true; }
+
+		template <typename V>
+		bool operator!=(const btree_allocator<V>&) const noexcept { return false; }
+};
+
+#endif
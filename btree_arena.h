@@ -0,0 +1,149 @@
+/**
+ * The node store behind a btree.
+ *
+ * Nodes are made in place inside a few large chunks instead of one heap
+ * block each, and link to one another by 32-bit handle rather than by
+ * pointer: a parent link is 4 bytes instead of 8, and so is every child
+ * slot.  Handles are positions, not addresses, so a tree's links mean
+ * the same thing wherever its chunks end up, which is what a serialiser
+ * or a memory-mapped copy needs.
+ *
+ * The first chunks double in size, chunk c holding the handles from 2^c
+ * up to 2^(c+1) - 1, so a small tree allocates little; from 1024 nodes
+ * on every chunk holds 1024, so no more than that many slots are ever
+ * allocated and unused.  Finding a node is a count-leading-zeros or a
+ * shift, and an offset.  Nodes never move once made, so pointers to them
+ * stay good until the store is cleared.  Handle 0 is never made and
+ * stands for no node.
+ */
+
+#ifndef BTREE_ARENA_H
+#define BTREE_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "btree_alloc.h"
+
+template <typename Node>
+class btree_arena {
+	public:
+		using handle = std::uint32_t;
+
+		btree_arena() : size_{0} { }
+		~btree_arena() { clear(); }
+
+		btree_arena(const btree_arena&) = delete;
+		btree_arena& operator=(const btree_arena&) = delete;
+
+		/**
+		 * Makes a node from the arguments and returns its handle.
+		 *
+		 * @throw std::length_error once 2^32 - 1 nodes have been made
+		 */
+		template <typename... Args>
+		handle make(Args&&... args);
+
+		/**
+		 * The node with the given handle, or nullptr for handle 0.
+		 */
+		Node* at(handle h) const {
+			if(!h) return nullptr;
+			if(h < kChunkNodes){
+				unsigned c = 31 - __builtin_clz(h);
+				return chunks_[c] + (h - (handle{1} << c));
+			}
+			return chunks_[kChunkBits - 1 + (h >> kChunkBits)] + (h & (kChunkNodes - 1));
+		}
+
+		/**
+		 * Nodes made so far.
+		 */
+		size_t size() const { return size_; }
+
+		/**
+		 * Heap bytes held for nodes, including slots not yet used.
+		 */
+		size_t bytes() const {
+			size_t slots = 0;
+			for(size_t c = 0; c < chunks_.size(); ++c) slots += chunk_nodes(c);
+			return slots * sizeof(Node) + chunks_.capacity() * sizeof(Node*);
+		}
+
+		/**
+		 * Allocates the chunks for nodes up to handle count in advance,
+		 * so that making them allocates nothing.
+		 */
+		void reserve(size_t count);
+
+		/**
+		 * Destroys the nodes with handles past count, keeping their
+		 * chunks for the nodes made next.
+		 */
+		void truncate(size_t count);
+
+		/**
+		 * Destroys every node and frees the chunks.
+		 */
+		void clear();
+
+	private:
+		static const unsigned kChunkBits = 10;
+		static const handle kChunkNodes = handle{1} << kChunkBits;
+
+		static size_t chunk_nodes(size_t c) { return c < kChunkBits ? size_t{1} << c : kChunkNodes; }
+		static size_t chunk_of(size_t h) { return h < kChunkNodes ? 31 - __builtin_clz(static_cast<handle>(h)) : kChunkBits - 1 + (h >> kChunkBits); }
+
+		size_t size_;
+		std::vector<Node*, btree_allocator<Node*>> chunks_;
+};
+
+template <typename Node>
+template <typename... Args>
+auto btree_arena<Node>::make(Args&&... args)
+	-> handle {
+
+	if(size_ == ~handle{0}) throw std::length_error("btree_arena: out of handles");
+	handle h = static_cast<handle>(size_ + 1);
+	// a handle that is a power of two, or a multiple of a full chunk,
+	// starts a new chunk, unless reserve made it already
+	if(((h & (h - 1)) == 0 || (h >= kChunkNodes && (h & (kChunkNodes - 1)) == 0)) && chunk_of(h) == chunks_.size()){
+		chunks_.reserve(chunks_.size() + 1);
+		chunks_.push_back(static_cast<Node*>(btree_alloc::allocate(chunk_nodes(chunks_.size()) * sizeof(Node))));
+	}
+	new (at(h)) Node(std::forward<Args>(args)...);
+	++size_;
+	return h;
+}
+
+template <typename Node>
+void btree_arena<Node>::reserve(size_t count) {
+	if(count == 0) return;
+	if(count > ~handle{0}) count = ~handle{0};
+	size_t chunks = chunk_of(count) + 1;
+	chunks_.reserve(chunks);
+	while(chunks_.size() < chunks){
+		chunks_.push_back(static_cast<Node*>(btree_alloc::allocate(chunk_nodes(chunks_.size()) * sizeof(Node))));
+	}
+}
+
+template <typename Node>
+void btree_arena<Node>::truncate(size_t count) {
+	for(; size_ > count; --size_) at(static_cast<handle>(size_))->~Node();
+}
+
+template <typename Node>
+void btree_arena<Node>::clear() {
+	for(size_t h = size_; h > 0; --h) at(static_cast<handle>(h))->~Node();
+	for(size_t c = 0; c < chunks_.size(); ++c){
+		btree_alloc::deallocate(chunks_[c], chunk_nodes(c) * sizeof(Node));
+	}
+	chunks_.clear();
+	size_ = 0;
+}
+
+#endif
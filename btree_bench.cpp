@@ -0,0 +1,846 @@
+/**
+ * Benchmark harness for the B-Tree.
+ *
+ * Measures insert, find (hit and miss), forward and reverse iteration,
+ * copy and destruction for btree<long> and btree<std::string> across a
+ * range of node sizes, plus btrees with their Bloom filter or hash index
+ * enabled, a frozen snapshot and (for long) a learned index, packed set
+ * and bitmap set, alongside std::set, a sorted std::vector and
+ * std::unordered_set holding the same keys.  Every figure is reported in
+ * nanoseconds per element, together with the heap bytes each container
+ * holds per element.
+ *
+ * The harness has no dependencies beyond the standard library.  Keys come
+ * from the seeded generators in btree_workload.h, so every run benchmarks
+ * exactly the same workload, and each timing is the median of several
+ * repetitions.  Lookups follow the same distribution as the inserts.
+ *
+ * A second table gives latency percentiles for individual inserts, finds
+ * and iterator increments, each timed on its own and gathered into a
+ * latency_histogram; --csv and --json also write it to a file.
+ *
+ * Where Linux perf_event_open is permitted, a third table gives the
+ * instructions, cache misses, branch misses and dTLB misses per insert,
+ * find and scanned element.  Otherwise the table is replaced by a note
+ * saying why the counters are unavailable.
+ *
+ * The Makefile builds it with BTREE_ALLOC_STATS, so the tree counts its
+ * own allocations; a table gives allocations and bytes per insert, the
+ * peak heap use while building, and allocations and bytes per element
+ * copied.
+ *
+ * Built with BTREE_HOT_COUNTERS (`make bench-counters'), it also prints
+ * the tree's own exact counts: comparisons and nodes visited per find and
+ * insert, parent climbs per iterator step and nodes allocated.
+ *
+ * Usage: btree_bench [elements] [repetitions] [distribution]
+ *                    [--csv=file] [--json=file]
+ **/
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <memory>
+#include <new>
+#include <set>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "btree.h"
+#include "btree_bitmap.h"
+#include "btree_histogram.h"
+#include "btree_learned.h"
+#include "btree_packed.h"
+#include "btree_perf.h"
+#include "btree_workload.h"
+
+namespace {
+
+// heap bytes currently held by the program, maintained by the
+// replacement operator new / delete below
+std::size_t liveBytes = 0;
+
+// every allocation is prefixed by a header recording its size
+const std::size_t kHeader = alignof(std::max_align_t);
+
+}  // namespace close
+
+void* operator new(std::size_t size) {
+  void *raw = std::malloc(size + kHeader);
+  if (!raw) throw std::bad_alloc();
+  *static_cast<std::size_t*>(raw) = size;
+  liveBytes += size;
+  return static_cast<char*>(raw) + kHeader;
+}
+
+void operator delete(void *ptr) noexcept {
+  if (!ptr) return;
+  // step back through an integer so the compiler does not mistake the
+  // header for an access before the start of the client's object
+  auto raw = reinterpret_cast<std::size_t*>(
+      reinterpret_cast<std::uintptr_t>(ptr) - kHeader);
+  liveBytes -= *raw;
+  std::free(raw);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+  operator delete(ptr);
+}
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+const std::vector<size_t> kNodeSizes = {4, 16, 40, 128};
+
+// keeps the optimiser from discarding lookups and traversals
+volatile std::size_t sink;
+
+/**
+ * The keys of one benchmark workload, as integers.  Hits are even and
+ * misses odd, so the two never overlap, and each miss sits right next to
+ * a hit so misses land in the same regions of the tree.
+ **/
+struct keyset {
+  vector<long> hits;    // distinct, in insertion order
+  vector<long> probes;  // lookups of hits, following the distribution
+  vector<long> misses;
+};
+
+keyset makeKeys(workload::distribution dist, std::size_t n) {
+  keyset ks;
+  workload::key_generator gen(dist, 0, (1L << 40) - 1, 6771);
+  std::unordered_set<long> seen;
+  for (auto k : gen.take(n)) {
+    if (seen.insert(k).second) ks.hits.push_back(k * 2);
+  }
+
+  workload::key_generator pick(dist, 0, ks.hits.size() - 1, 3000);
+  for (auto i : pick.take(ks.hits.size())) {
+    ks.probes.push_back(ks.hits[i]);
+    ks.misses.push_back(ks.hits[i] + 1);
+  }
+  return ks;
+}
+
+template <typename T>
+vector<T> convert(const vector<long> &keys) {
+  vector<T> out;
+  out.reserve(keys.size());
+  for (auto k : keys) out.push_back(workload::make_key<T>(k));
+  return out;
+}
+
+std::size_t weight(long v) { return static_cast<std::size_t>(v); }
+std::size_t weight(const string &v) { return v.size(); }
+
+/**
+ * Uniform interface over the containers being compared.  Containers
+ * without a notion of node size ignore it.
+ **/
+template <typename C> struct adaptor;
+
+template <typename T>
+struct adaptor<btree<T>> {
+  static const bool ordered = true;
+  static btree<T>* make(size_t nodeSize) { return new btree<T>(nodeSize); }
+  static void insert(btree<T> &c, const T &k) { c.insert(k); }
+  static void build(btree<T> &c, const vector<T> &keys) {
+    for (const auto &k : keys) c.insert(k);
+  }
+  static bool contains(const btree<T> &c, const T &k) {
+    return c.find(k) != c.end();
+  }
+};
+
+/**
+ * A btree with its Bloom filter enabled, so most misses skip the descent.
+ **/
+template <typename T>
+struct bloomed : btree<T> {
+  explicit bloomed(size_t nodeSize) : btree<T>(nodeSize) {
+    this->enable_bloom();
+  }
+};
+
+template <typename T>
+struct adaptor<bloomed<T>> : adaptor<btree<T>> {
+  static bloomed<T>* make(size_t nodeSize) { return new bloomed<T>(nodeSize); }
+};
+
+/**
+ * A btree with its hash index enabled, so finds skip the descent.
+ **/
+template <typename T>
+struct hashed : btree<T> {
+  explicit hashed(size_t nodeSize) : btree<T>(nodeSize) {
+    this->enable_hash_index();
+  }
+};
+
+template <typename T>
+struct adaptor<hashed<T>> : adaptor<btree<T>> {
+  static hashed<T>* make(size_t nodeSize) { return new hashed<T>(nodeSize); }
+};
+
+/**
+ * A frozen snapshot is built by filling a btree and freezing it, which is
+ * how one is made in practice.
+ **/
+template <typename T>
+struct adaptor<frozen_btree<T>> {
+  static const bool ordered = true;
+  static frozen_btree<T>* make(size_t) { return new frozen_btree<T>(); }
+  static void build(frozen_btree<T> &c, const vector<T> &keys) {
+    btree<T> tree;
+    for (const auto &k : keys) tree.insert(k);
+    c = tree.freeze();
+  }
+  static bool contains(const frozen_btree<T> &c, const T &k) {
+    return c.contains(k);
+  }
+};
+
+/**
+ * A learned index is built over the sorted, distinct keys.
+ **/
+template <typename T>
+struct adaptor<learned_index<T>> {
+  static const bool ordered = true;
+  static learned_index<T>* make(size_t) { return new learned_index<T>(); }
+  static void build(learned_index<T> &c, const vector<T> &keys) {
+    vector<T> sorted(keys);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    c = learned_index<T>(sorted.begin(), sorted.end());
+  }
+  static bool contains(const learned_index<T> &c, const T &k) {
+    return c.contains(k);
+  }
+};
+
+/**
+ * A packed set is built over the sorted, distinct keys.
+ **/
+template <typename T>
+struct adaptor<packed_set<T>> {
+  static const bool ordered = true;
+  static packed_set<T>* make(size_t) { return new packed_set<T>(); }
+  static void build(packed_set<T> &c, const vector<T> &keys) {
+    vector<T> sorted(keys);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    c = packed_set<T>(sorted.begin(), sorted.end());
+  }
+  static bool contains(const packed_set<T> &c, const T &k) {
+    return c.contains(k);
+  }
+};
+
+/**
+ * A bitmap set is built over the sorted, distinct keys.  Its iterators
+ * only go forwards, so it has no reverse scan.
+ **/
+template <typename T>
+struct adaptor<bitmap_set<T>> {
+  static const bool ordered = false;
+  static bitmap_set<T>* make(size_t) { return new bitmap_set<T>(); }
+  static void build(bitmap_set<T> &c, const vector<T> &keys) {
+    vector<T> sorted(keys);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    c = bitmap_set<T>(sorted.begin(), sorted.end());
+  }
+  static bool contains(const bitmap_set<T> &c, const T &k) {
+    return c.contains(k);
+  }
+};
+
+template <typename T>
+struct adaptor<std::set<T>> {
+  static const bool ordered = true;
+  static std::set<T>* make(size_t) { return new std::set<T>(); }
+  static void insert(std::set<T> &c, const T &k) { c.insert(k); }
+  static void build(std::set<T> &c, const vector<T> &keys) {
+    for (const auto &k : keys) c.insert(k);
+  }
+  static bool contains(const std::set<T> &c, const T &k) {
+    return c.find(k) != c.end();
+  }
+};
+
+/**
+ * A sorted vector is built in bulk (append, sort, unique), which is how
+ * one is populated in practice; inserting element by element would be
+ * quadratic.
+ **/
+template <typename T>
+struct adaptor<vector<T>> {
+  static const bool ordered = true;
+  static vector<T>* make(size_t) { return new vector<T>(); }
+  static void build(vector<T> &c, const vector<T> &keys) {
+    c.insert(c.end(), keys.begin(), keys.end());
+    std::sort(c.begin(), c.end());
+    c.erase(std::unique(c.begin(), c.end()), c.end());
+    c.shrink_to_fit();
+  }
+  static bool contains(const vector<T> &c, const T &k) {
+    return std::binary_search(c.begin(), c.end(), k);
+  }
+};
+
+template <typename T>
+struct adaptor<std::unordered_set<T>> {
+  static const bool ordered = false;
+  static std::unordered_set<T>* make(size_t) {
+    return new std::unordered_set<T>();
+  }
+  static void insert(std::unordered_set<T> &c, const T &k) { c.insert(k); }
+  static void build(std::unordered_set<T> &c, const vector<T> &keys) {
+    for (const auto &k : keys) c.insert(k);
+  }
+  static bool contains(const std::unordered_set<T> &c, const T &k) {
+    return c.find(k) != c.end();
+  }
+};
+
+/**
+ * Median nanoseconds per element of the given operations.
+ **/
+struct result {
+  double insert, findHit, findMiss, iterate, reverse, copy, destroy;
+  double bytes;
+};
+
+double nsPerElem(clock_type::duration d, std::size_t n) {
+  return std::chrono::duration<double, std::nano>(d).count() / n;
+}
+
+double median(vector<double> v) {
+  std::sort(v.begin(), v.end());
+  return v[v.size() / 2];
+}
+
+template <typename C>
+typename std::enable_if<adaptor<C>::ordered, std::size_t>::type
+reverseScan(const C &c) {
+  std::size_t acc = 0;
+  for (auto it = c.rbegin(); it != c.rend(); ++it) acc += weight(*it);
+  return acc;
+}
+
+template <typename C>
+typename std::enable_if<!adaptor<C>::ordered, std::size_t>::type
+reverseScan(const C &) {
+  return 0;
+}
+
+template <typename C, typename T>
+result measure(size_t nodeSize, const vector<T> &hits,
+               const vector<T> &misses, const vector<T> &probes,
+               unsigned reps) {
+  using A = adaptor<C>;
+  const std::size_t n = hits.size();
+  vector<double> insert, findHit, findMiss, iterate, reverse, copy, destroy;
+  double bytes = 0;
+
+  for (unsigned r = 0; r < reps; ++r) {
+    std::size_t before = liveBytes;
+    auto start = clock_type::now();
+    std::unique_ptr<C> c(A::make(nodeSize));
+    A::build(*c, hits);
+    insert.push_back(nsPerElem(clock_type::now() - start, n));
+    bytes = static_cast<double>(liveBytes - before) / n;
+
+    const C &cc = *c;
+    std::size_t found = 0;
+    start = clock_type::now();
+    for (const auto &k : probes) found += A::contains(cc, k);
+    findHit.push_back(nsPerElem(clock_type::now() - start, n));
+
+    start = clock_type::now();
+    for (const auto &k : misses) found += A::contains(cc, k);
+    findMiss.push_back(nsPerElem(clock_type::now() - start, n));
+    if (found != n) {
+      std::cerr << "benchmark container lost elements" << endl;
+      std::exit(1);
+    }
+
+    std::size_t acc = 0;
+    start = clock_type::now();
+    for (const auto &v : cc) acc += weight(v);
+    iterate.push_back(nsPerElem(clock_type::now() - start, n));
+
+    start = clock_type::now();
+    acc += reverseScan(cc);
+    reverse.push_back(nsPerElem(clock_type::now() - start, n));
+    sink = acc;
+
+    start = clock_type::now();
+    std::unique_ptr<C> dup(new C(cc));
+    copy.push_back(nsPerElem(clock_type::now() - start, n));
+
+    start = clock_type::now();
+    dup.reset();
+    c.reset();
+    destroy.push_back(nsPerElem(clock_type::now() - start, 2 * n));
+  }
+
+  return {median(insert), median(findHit), median(findMiss), median(iterate),
+          A::ordered ? median(reverse) : -1, median(copy), median(destroy),
+          bytes};
+}
+
+void printHeader(const string &title) {
+  cout << title << " (ns/element)" << endl;
+  cout << std::left << std::setw(16) << "container" << std::right
+       << std::setw(6) << "node" << std::setw(9) << "insert"
+       << std::setw(9) << "hit" << std::setw(9) << "miss"
+       << std::setw(9) << "iter" << std::setw(9) << "riter"
+       << std::setw(9) << "copy" << std::setw(9) << "destroy"
+       << std::setw(11) << "bytes/elem" << endl;
+}
+
+void printRow(const string &name, const string &node, const result &r) {
+  auto cell = [](double v) {
+    std::ostringstream os;
+    if (v < 0) os << "-";
+    else os << std::fixed << std::setprecision(1) << v;
+    return os.str();
+  };
+  cout << std::left << std::setw(16) << name << std::right
+       << std::setw(6) << node << std::setw(9) << cell(r.insert)
+       << std::setw(9) << cell(r.findHit) << std::setw(9) << cell(r.findMiss)
+       << std::setw(9) << cell(r.iterate) << std::setw(9) << cell(r.reverse)
+       << std::setw(9) << cell(r.copy) << std::setw(9) << cell(r.destroy)
+       << std::setw(11) << cell(r.bytes) << endl;
+}
+
+/**
+ * Learned indexes, packed sets and bitmap sets only take integral keys,
+ * so there are no such rows for strings.
+ **/
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value>::type
+printIntegerRows(const vector<T> &hits, const vector<T> &misses,
+                 const vector<T> &probes, unsigned reps) {
+  printRow("learned", "-",
+           measure<learned_index<T>>(0, hits, misses, probes, reps));
+  printRow("packed", "-",
+           measure<packed_set<T>>(0, hits, misses, probes, reps));
+  printRow("bitmap", "-",
+           measure<bitmap_set<T>>(0, hits, misses, probes, reps));
+}
+
+template <typename T>
+typename std::enable_if<!std::is_integral<T>::value>::type
+printIntegerRows(const vector<T> &, const vector<T> &, const vector<T> &,
+                 unsigned) { }
+
+/**
+ * Latency distributions of individual operations on one container.
+ **/
+struct latencies {
+  latency_histogram insert, find, increment;
+};
+
+/**
+ * One row of the latency table, kept for the CSV and JSON reports.
+ **/
+struct latencyRow {
+  string type, container, node, op;
+  const latency_histogram *hist;
+};
+
+template <typename C, typename T>
+latencies measureLatency(size_t nodeSize, const vector<T> &hits,
+                         const vector<T> &probes, unsigned reps) {
+  using A = adaptor<C>;
+  latencies lat;
+  auto elapsed = [](clock_type::time_point start) {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock_type::now() - start).count());
+  };
+
+  for (unsigned r = 0; r < reps; ++r) {
+    std::unique_ptr<C> c(A::make(nodeSize));
+    for (const auto &k : hits) {
+      auto start = clock_type::now();
+      A::insert(*c, k);
+      lat.insert.record(elapsed(start));
+    }
+
+    const C &cc = *c;
+    std::size_t found = 0;
+    for (const auto &k : probes) {
+      auto start = clock_type::now();
+      found += A::contains(cc, k);
+      lat.find.record(elapsed(start));
+    }
+
+    std::size_t acc = 0;
+    auto end = cc.end();
+    for (auto it = cc.begin(); it != end;) {
+      acc += weight(*it);
+      auto start = clock_type::now();
+      ++it;
+      lat.increment.record(elapsed(start));
+    }
+    sink = acc + found;
+  }
+  return lat;
+}
+
+void printLatencyHeader(const string &title, std::uint64_t overhead) {
+  cout << title << " latency (ns, including ~" << overhead
+       << " ns of clock overhead)" << endl;
+  cout << std::left << std::setw(16) << "container" << std::right
+       << std::setw(6) << "node" << std::setw(11) << "op"
+       << std::setw(9) << "mean" << std::setw(9) << "p50"
+       << std::setw(9) << "p99" << std::setw(9) << "p99.9"
+       << std::setw(10) << "max" << endl;
+}
+
+void printLatencyRow(const latencyRow &row) {
+  const latency_histogram &h = *row.hist;
+  cout << std::left << std::setw(16) << row.container << std::right
+       << std::setw(6) << row.node << std::setw(11) << row.op
+       << std::setw(9) << std::fixed << std::setprecision(1) << h.mean()
+       << std::setw(9) << h.percentile(50) << std::setw(9) << h.percentile(99)
+       << std::setw(9) << h.percentile(99.9) << std::setw(10) << h.max()
+       << endl;
+}
+
+void writeCsv(std::ostream &os, const vector<latencyRow> &rows) {
+  os << "type,container,node,op,count,mean,p50,p90,p99,p99.9,max" << endl;
+  for (const auto &row : rows) {
+    const latency_histogram &h = *row.hist;
+    os << row.type << ',' << row.container << ',' << row.node << ','
+       << row.op << ',' << h.count() << ',' << h.mean() << ','
+       << h.percentile(50) << ',' << h.percentile(90) << ','
+       << h.percentile(99) << ',' << h.percentile(99.9) << ',' << h.max()
+       << endl;
+  }
+}
+
+void writeJson(std::ostream &os, const vector<latencyRow> &rows) {
+  os << "[" << endl;
+  for (std::size_t i = 0; i < rows.size(); ++i) {
+    const latencyRow &row = rows[i];
+    const latency_histogram &h = *row.hist;
+    os << "  {\"type\": \"" << row.type << "\", \"container\": \""
+       << row.container << "\", \"node\": \"" << row.node
+       << "\", \"op\": \"" << row.op << "\", \"count\": " << h.count()
+       << ", \"mean\": " << h.mean() << ", \"p50\": " << h.percentile(50)
+       << ", \"p90\": " << h.percentile(90) << ", \"p99\": "
+       << h.percentile(99) << ", \"p99.9\": " << h.percentile(99.9)
+       << ", \"max\": " << h.max() << "}" << (i + 1 < rows.size() ? "," : "")
+       << endl;
+  }
+  os << "]" << endl;
+}
+
+/**
+ * The cheapest back-to-back pair of clock reads, which every latency
+ * sample includes.
+ **/
+std::uint64_t clockOverhead() {
+  std::uint64_t best = std::numeric_limits<std::uint64_t>::max();
+  for (int i = 0; i < 1000; ++i) {
+    auto a = clock_type::now();
+    auto b = clock_type::now();
+    best = std::min<std::uint64_t>(best,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(b - a).count());
+  }
+  return best;
+}
+
+/**
+ * Hardware event counts per operation for the insert, find and scan
+ * phases of one container, indexed by perf_counters::event.
+ **/
+struct counts {
+  double insert[perf_counters::events];
+  double find[perf_counters::events];
+  double scan[perf_counters::events];
+};
+
+template <typename C, typename T>
+counts measureCounters(perf_counters &perf, size_t nodeSize,
+                       const vector<T> &hits, const vector<T> &probes) {
+  using A = adaptor<C>;
+  const std::size_t n = hits.size();
+  counts out;
+  auto latch = [&perf, n](double *into) {
+    for (std::size_t e = 0; e < perf_counters::events; ++e) {
+      into[e] = static_cast<double>(
+          perf.value(static_cast<perf_counters::event>(e))) / n;
+    }
+  };
+
+  std::unique_ptr<C> c(A::make(nodeSize));
+  perf.start();
+  A::build(*c, hits);
+  perf.stop();
+  latch(out.insert);
+
+  const C &cc = *c;
+  std::size_t acc = 0;
+  perf.start();
+  for (const auto &k : probes) acc += A::contains(cc, k);
+  perf.stop();
+  latch(out.find);
+
+  perf.start();
+  for (const auto &v : cc) acc += weight(v);
+  perf.stop();
+  latch(out.scan);
+  sink = acc;
+  return out;
+}
+
+void printCounters(const string &title, perf_counters &perf) {
+  cout << title << " hardware events per operation" << endl;
+  cout << std::left << std::setw(16) << "container" << std::right
+       << std::setw(6) << "node" << std::setw(8) << "op";
+  for (std::size_t e = 0; e < perf_counters::events; ++e) {
+    cout << std::setw(15) << perf_counters::name(static_cast<perf_counters::event>(e));
+  }
+  cout << endl;
+}
+
+void printCountersRow(const string &name, const string &node,
+                      const perf_counters &perf, const counts &c) {
+  auto row = [&](const char *op, const double *values) {
+    cout << std::left << std::setw(16) << name << std::right
+         << std::setw(6) << node << std::setw(8) << op;
+    for (std::size_t e = 0; e < perf_counters::events; ++e) {
+      if (perf.available(static_cast<perf_counters::event>(e))) {
+        cout << std::setw(15) << std::fixed << std::setprecision(2) << values[e];
+      } else {
+        cout << std::setw(15) << "n/a";
+      }
+    }
+    cout << endl;
+  };
+  row("insert", c.insert);
+  row("find", c.find);
+  row("scan", c.scan);
+}
+
+#ifdef BTREE_HOT_COUNTERS
+/**
+ * Prints the btree's hot-path counters for building a tree of the given
+ * node size, finding every probe and scanning the tree once each way.
+ **/
+template <typename T>
+void printHotPath(size_t nodeSize, const vector<T> &hits,
+                  const vector<T> &probes) {
+  btree<T> tree(nodeSize);
+  btree_counters::reset();
+  adaptor<btree<T>>::build(tree, hits);
+  btree_hot_counters build = btree_counters::snapshot();
+
+  btree_counters::reset();
+  std::size_t acc = 0;
+  for (const auto &k : probes) acc += adaptor<btree<T>>::contains(tree, k);
+  btree_hot_counters find = btree_counters::snapshot();
+
+  btree_counters::reset();
+  acc += reverseScan(tree);
+  for (const auto &v : tree) acc += weight(v);
+  btree_hot_counters scan = btree_counters::snapshot();
+  sink = acc;
+
+  auto per = [](std::uint64_t a, std::uint64_t b) {
+    return b ? static_cast<double>(a) / b : 0.0;
+  };
+  cout << std::right << std::setw(6) << nodeSize << std::fixed
+       << std::setprecision(2)
+       << std::setw(12) << per(build.comparisons, build.inserts)
+       << std::setw(12) << per(build.insert_visits, build.inserts)
+       << std::setw(12) << per(build.node_allocations, build.inserts)
+       << std::setw(12) << per(find.comparisons, find.finds)
+       << std::setw(12) << per(find.find_visits, find.finds)
+       << std::setw(12) << per(scan.parent_climbs, 2 * hits.size()) << endl;
+}
+#endif
+
+/**
+ * Prints what btree_alloc saw while building a tree of the given node
+ * size and copying it.  Every figure is zero unless the harness was
+ * built with BTREE_ALLOC_STATS.
+ **/
+template <typename T>
+void printAllocations(size_t nodeSize, const vector<T> &hits) {
+  const double n = static_cast<double>(hits.size());
+  btree_alloc::reset();
+  btree_alloc_stats start = btree_alloc::snapshot();
+  btree_alloc_stats built, copied;
+  {
+    btree<T> tree(nodeSize);
+    adaptor<btree<T>>::build(tree, hits);
+    built = btree_alloc::snapshot();
+    btree<T> copy(tree);
+    copied = btree_alloc::snapshot();
+  }
+
+  cout << std::right << std::setw(6) << nodeSize << std::fixed
+       << std::setprecision(2)
+       << std::setw(13) << (built.allocations - start.allocations) / n
+       << std::setw(13) << (built.bytes_allocated - start.bytes_allocated) / n
+       << std::setw(13) << (built.peak_bytes - start.live_bytes) / n
+       << std::setw(13) << (copied.allocations - built.allocations) / n
+       << std::setw(13) << (copied.bytes_allocated - built.bytes_allocated) / n
+       << endl;
+}
+
+template <typename T>
+void runSuite(const string &title, const keyset &ks, unsigned reps,
+              std::list<latencies> &kept, vector<latencyRow> &rows) {
+  const vector<T> hits = convert<T>(ks.hits);
+  const vector<T> misses = convert<T>(ks.misses);
+  const vector<T> probes = convert<T>(ks.probes);
+
+  printHeader(title);
+  for (auto size : kNodeSizes) {
+    printRow("btree", std::to_string(size),
+             measure<btree<T>>(size, hits, misses, probes, reps));
+  }
+  printRow("btree+bloom", "40",
+           measure<bloomed<T>>(40, hits, misses, probes, reps));
+  printRow("btree+hash", "40",
+           measure<hashed<T>>(40, hits, misses, probes, reps));
+  printRow("frozen", "-",
+           measure<frozen_btree<T>>(0, hits, misses, probes, reps));
+  printIntegerRows(hits, misses, probes, reps);
+  printRow("std::set", "-",
+           measure<std::set<T>>(0, hits, misses, probes, reps));
+  printRow("sorted vector", "-",
+           measure<vector<T>>(0, hits, misses, probes, reps));
+  printRow("unordered_set", "-",
+           measure<std::unordered_set<T>>(0, hits, misses, probes, reps));
+  cout << endl;
+
+  auto add = [&](const string &container, const string &node,
+                 latencies lat) {
+    kept.push_back(std::move(lat));
+    latencies &l = kept.back();
+    rows.push_back({title, container, node, "insert", &l.insert});
+    rows.push_back({title, container, node, "find", &l.find});
+    rows.push_back({title, container, node, "increment", &l.increment});
+    for (std::size_t i = rows.size() - 3; i < rows.size(); ++i) {
+      printLatencyRow(rows[i]);
+    }
+  };
+  printLatencyHeader(title, clockOverhead());
+  for (auto size : kNodeSizes) {
+    add("btree", std::to_string(size),
+        measureLatency<btree<T>>(size, hits, probes, reps));
+  }
+  add("std::set", "-", measureLatency<std::set<T>>(0, hits, probes, reps));
+  add("unordered_set", "-",
+      measureLatency<std::unordered_set<T>>(0, hits, probes, reps));
+  cout << endl;
+
+  if (btree_alloc::counting) {
+    cout << title << " btree allocations per element" << endl;
+    cout << std::setw(6) << "node" << std::setw(13) << "ins allocs"
+         << std::setw(13) << "ins bytes" << std::setw(13) << "peak bytes"
+         << std::setw(13) << "copy allocs" << std::setw(13) << "copy bytes"
+         << endl;
+    for (auto size : kNodeSizes) printAllocations(size, hits);
+    cout << endl;
+  }
+
+#ifdef BTREE_HOT_COUNTERS
+  cout << title << " hot-path counters per operation" << endl;
+  cout << std::setw(6) << "node" << std::setw(12) << "ins cmps"
+       << std::setw(12) << "ins nodes" << std::setw(12) << "ins allocs"
+       << std::setw(12) << "find cmps" << std::setw(12) << "find nodes"
+       << std::setw(12) << "step climbs" << endl;
+  for (auto size : kNodeSizes) printHotPath(size, hits, probes);
+  cout << endl;
+#endif
+
+  perf_counters perf;
+  if (!perf.available()) {
+    cout << title << " hardware events: unavailable (" << perf.reason()
+         << ")" << endl << endl;
+    return;
+  }
+  printCounters(title, perf);
+  for (auto size : kNodeSizes) {
+    printCountersRow("btree", std::to_string(size), perf,
+                     measureCounters<btree<T>>(perf, size, hits, probes));
+  }
+  printCountersRow("std::set", "-", perf,
+                   measureCounters<std::set<T>>(perf, 0, hits, probes));
+  cout << endl;
+}
+
+}  // namespace close
+
+int main(int argc, char *argv[]) {
+  vector<string> args;
+  string csvFile, jsonFile;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg.compare(0, 6, "--csv=") == 0) csvFile = arg.substr(6);
+    else if (arg.compare(0, 7, "--json=") == 0) jsonFile = arg.substr(7);
+    else args.push_back(arg);
+  }
+
+  std::size_t n = args.size() > 0 ? std::strtoul(args[0].c_str(), nullptr, 10) : 100000;
+  unsigned reps = args.size() > 1 ? std::strtoul(args[1].c_str(), nullptr, 10) : 5;
+  workload::distribution dist = workload::distribution::uniform;
+  try {
+    if (args.size() > 2) dist = workload::parse_distribution(args[2]);
+  } catch (const std::invalid_argument &e) {
+    std::cerr << e.what() << endl;
+    n = 0;
+  }
+  if (n == 0 || reps == 0 || args.size() > 3) {
+    std::cerr << "usage: " << argv[0]
+              << " [elements] [repetitions] [distribution]"
+                 " [--csv=file] [--json=file]" << endl;
+    return 1;
+  }
+
+  keyset ks = makeKeys(dist, n);
+  cout << ks.hits.size() << " distinct " << workload::to_string(dist)
+       << " keys, median of " << reps << " runs" << endl << endl;
+
+  std::list<latencies> kept;
+  vector<latencyRow> rows;
+  runSuite<long>("btree<long>", ks, reps, kept, rows);
+  runSuite<string>("btree<std::string>", ks, reps, kept, rows);
+
+  if (!csvFile.empty()) {
+    std::ofstream os(csvFile);
+    writeCsv(os, rows);
+  }
+  if (!jsonFile.empty()) {
+    std::ofstream os(jsonFile);
+    writeJson(os, rows);
+  }
+
+  return 0;
+}
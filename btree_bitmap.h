@@ -0,0 +1,386 @@
+/**
+ * A compressed, read-only set of integer keys in the style of Roaring
+ * bitmaps, for frozen trees whose keys are dense within ranges.
+ *
+ * The key space is cut into chunks of 65536 consecutive values, and each
+ * chunk holding any key is stored in whichever of three containers is
+ * smallest for it:
+ *
+ *   - an array of the keys' low 16 bits, 2 bytes a key, for sparse chunks;
+ *   - a bitmap of all 65536 values, 8 KB, for chunks of more than 4096
+ *     keys, down to a single bit a key for a full chunk, 64 times less
+ *     than a long;
+ *   - a list of runs of consecutive keys, 4 bytes a run, for chunks made
+ *     of a few long runs.
+ *
+ * Membership is a binary search over the chunks and then a lookup in one
+ * container.  rank() counts bitmap words with popcount, and iteration
+ * steps through set bits with count-trailing-zeros, so scans never test
+ * values one at a time.
+ *
+ * Nodes of the mutable tree hand out references to their elements, so
+ * they cannot hold keys in encoded form; this is a snapshot, built from
+ * the sorted contents of a tree:
+ *
+ *     bitmap_set<long> keys(tree.begin(), tree.end());
+ */
+
+#ifndef BTREE_BITMAP_H
+#define BTREE_BITMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include "btree_alloc.h"
+#include "btree_key_bits.h"
+
+template <typename K>
+class bitmap_set {
+	static_assert(std::is_integral<K>::value, "a bitmap set needs integral keys");
+
+	public:
+		enum container { array, bitmap, runs };
+
+		class const_iterator {
+			public:
+				typedef std::ptrdiff_t difference_type;
+				typedef std::forward_iterator_tag iterator_category;
+				typedef K value_type;
+				typedef const K* pointer;
+				typedef K reference;
+
+				const_iterator() : set_{nullptr}, chunk_{0}, at_{0}, low_{0} { }
+
+				K operator*() const { return set_->decode(set_->chunks_[chunk_].high, low_); }
+
+				bool operator==(const const_iterator &other) const {
+					return chunk_ == other.chunk_ && at_ == other.at_ && low_ == other.low_;
+				}
+				bool operator!=(const const_iterator &other) const { return !(*this == other); }
+
+				const_iterator& operator++() {
+					set_->advance(*this);
+					return *this;
+				}
+
+				const_iterator operator++(int) {
+					auto copy = *this;
+					operator++();
+					return copy;
+				}
+
+			private:
+				friend class bitmap_set;
+
+				const bitmap_set *set_;
+				size_t chunk_;          // chunks_.size() past the end
+				size_t at_;             // array index, bitmap word or run
+				std::uint32_t low_;     // the key's low 16 bits
+		};
+
+		using iterator = const_iterator;
+
+		bitmap_set() : size_{0} { }
+
+		/**
+		 * Encodes a sorted range.
+		 *
+		 * @param first, last distinct keys in ascending order
+		 */
+		template <typename InputIt>
+		bitmap_set(InputIt first, InputIt last);
+
+		size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+
+		/**
+		 * Heap bytes held by the set, and how many chunks use each
+		 * container.
+		 */
+		size_t bytes() const {
+			return chunks_.capacity() * sizeof(chunk) + lows_.capacity() * sizeof(std::uint16_t)
+				+ words_.capacity() * sizeof(std::uint64_t);
+		}
+		size_t chunks(container kind) const {
+			return std::count_if(chunks_.begin(), chunks_.end(), [kind](const chunk &c) { return c.kind == kind; });
+		}
+
+		const_iterator begin() const { return start(0); }
+		const_iterator end() const { return past(); }
+		const_iterator cbegin() const { return begin(); }
+		const_iterator cend() const { return end(); }
+
+		bool contains(K key) const;
+
+		/**
+		 * The first key not less than key, or end().
+		 */
+		const_iterator lower_bound(K key) const;
+
+		const_iterator find(K key) const {
+			auto it = lower_bound(key);
+			return it != end() && *it == key ? it : end();
+		}
+
+		/**
+		 * How many keys are less than key.
+		 */
+		size_t rank(K key) const;
+
+	private:
+		static const std::uint32_t kChunkBits = 16;
+		static const std::uint32_t kChunkValues = std::uint32_t{1} << kChunkBits;
+		static const size_t kBitmapWords = kChunkValues / 64;
+
+		struct chunk {
+			std::uint64_t high;     // the keys' bits above the low 16
+			container kind;
+			std::uint32_t count;    // lows_ entries (array: keys, runs: 2 a run) or words_
+			size_t offset;          // where those entries start
+			size_t before;          // keys in earlier chunks, for rank
+		};
+
+		static K decode(std::uint64_t high, std::uint32_t low) {
+			return key_bits<K>::decode((high << kChunkBits) | low);
+		}
+
+		void add(std::uint64_t high, const std::vector<std::uint16_t> &lows);
+
+		size_t chunkOf(std::uint64_t high) const {
+			return std::lower_bound(chunks_.begin(), chunks_.end(), high,
+					[](const chunk &c, std::uint64_t h) { return c.high < h; }) - chunks_.begin();
+		}
+
+		// the first key of chunk c whose low bits are at least low, or the
+		// first key of a later chunk
+		const_iterator seek(size_t c, std::uint32_t low) const;
+		const_iterator start(size_t c) const { return seek(c, 0); }
+		const_iterator past() const {
+			const_iterator it;
+			it.set_ = this;
+			it.chunk_ = chunks_.size();
+			return it;
+		}
+		void advance(const_iterator &it) const;
+
+		size_t size_;
+		std::vector<chunk, btree_allocator<chunk>> chunks_;
+		std::vector<std::uint16_t, btree_allocator<std::uint16_t>> lows_;    // arrays and runs
+		std::vector<std::uint64_t, btree_allocator<std::uint64_t>> words_;   // bitmaps
+};
+
+template <typename K>
+template <typename InputIt>
+bitmap_set<K>::bitmap_set(InputIt first, InputIt last) : size_{0} {
+	std::vector<std::uint16_t> lows;
+	std::uint64_t high = 0;
+	for(auto it = first; it != last; ++it){
+		std::uint64_t bits = key_bits<K>::encode(*it);
+		if(!lows.empty() && bits >> kChunkBits != high){
+			add(high, lows);
+			lows.clear();
+		}
+		high = bits >> kChunkBits;
+		lows.push_back(static_cast<std::uint16_t>(bits));
+	}
+	if(!lows.empty()) add(high, lows);
+	chunks_.shrink_to_fit();
+	lows_.shrink_to_fit();
+	words_.shrink_to_fit();
+}
+
+template <typename K>
+void bitmap_set<K>::add(std::uint64_t high, const std::vector<std::uint16_t> &lows) {
+	size_t runCount = 1;
+	for(size_t i = 1; i < lows.size(); ++i){
+		if(lows[i] != lows[i - 1] + 1) ++runCount;
+	}
+
+	// the smallest encoding, in bytes
+	size_t arrayBytes = 2 * lows.size(), bitmapBytes = kBitmapWords * 8, runBytes = 4 * runCount;
+	chunk c{high, array, 0, 0, size_};
+	if(runBytes < arrayBytes && runBytes < bitmapBytes){
+		c.kind = runs;
+		c.offset = lows_.size();
+		for(size_t i = 0; i < lows.size(); ++i){
+			if(i == 0 || lows[i] != lows[i - 1] + 1){
+				lows_.push_back(lows[i]);     // first key of the run
+				lows_.push_back(lows[i]);     // last key, extended below
+			}
+			else{
+				lows_.back() = lows[i];
+			}
+		}
+		c.count = static_cast<std::uint32_t>(lows_.size() - c.offset);
+	}
+	else if(bitmapBytes < arrayBytes){
+		c.kind = bitmap;
+		c.offset = words_.size();
+		c.count = kBitmapWords;
+		words_.resize(words_.size() + kBitmapWords, 0);
+		for(auto low : lows) words_[c.offset + low / 64] |= std::uint64_t{1} << (low % 64);
+	}
+	else{
+		c.offset = lows_.size();
+		c.count = static_cast<std::uint32_t>(lows.size());
+		lows_.insert(lows_.end(), lows.begin(), lows.end());
+	}
+	chunks_.push_back(c);
+	size_ += lows.size();
+}
+
+template <typename K>
+bool bitmap_set<K>::contains(K key) const {
+	std::uint64_t bits = key_bits<K>::encode(key);
+	size_t i = chunkOf(bits >> kChunkBits);
+	if(i == chunks_.size() || chunks_[i].high != bits >> kChunkBits) return false;
+
+	const chunk &c = chunks_[i];
+	std::uint16_t low = static_cast<std::uint16_t>(bits);
+	switch(c.kind){
+		case bitmap:
+			return words_[c.offset + low / 64] >> (low % 64) & 1;
+		case runs: {
+			// the last run starting at or before low
+			const std::uint16_t *first = lows_.data() + c.offset;
+			size_t lo = 0, hi = c.count / 2;
+			while(lo < hi){
+				size_t mid = (lo + hi) / 2;
+				if(first[2 * mid] <= low) lo = mid + 1;
+				else hi = mid;
+			}
+			return lo > 0 && low <= first[2 * (lo - 1) + 1];
+		}
+		default:
+			return std::binary_search(lows_.begin() + c.offset, lows_.begin() + c.offset + c.count, low);
+	}
+}
+
+template <typename K>
+size_t bitmap_set<K>::rank(K key) const {
+	std::uint64_t bits = key_bits<K>::encode(key);
+	size_t i = chunkOf(bits >> kChunkBits);
+	if(i == chunks_.size()) return size_;
+
+	const chunk &c = chunks_[i];
+	if(c.high != bits >> kChunkBits) return c.before;
+
+	std::uint32_t low = static_cast<std::uint16_t>(bits);
+	size_t below = 0;
+	switch(c.kind){
+		case bitmap: {
+			const std::uint64_t *words = words_.data() + c.offset;
+			for(size_t w = 0; w < low / 64; ++w) below += __builtin_popcountll(words[w]);
+			if(low % 64) below += __builtin_popcountll(words[low / 64] & ((std::uint64_t{1} << (low % 64)) - 1));
+			break;
+		}
+		case runs:
+			for(size_t r = 0; r < c.count && lows_[c.offset + r] < low; r += 2){
+				std::uint32_t first = lows_[c.offset + r], last = lows_[c.offset + r + 1];
+				below += std::min(last + 1, low) - first;
+			}
+			break;
+		default:
+			below = std::lower_bound(lows_.begin() + c.offset, lows_.begin() + c.offset + c.count, low)
+				- (lows_.begin() + c.offset);
+	}
+	return c.before + below;
+}
+
+template <typename K>
+auto bitmap_set<K>::lower_bound(K key) const
+	-> const_iterator {
+
+	std::uint64_t bits = key_bits<K>::encode(key);
+	size_t i = chunkOf(bits >> kChunkBits);
+	if(i < chunks_.size() && chunks_[i].high == bits >> kChunkBits){
+		return seek(i, static_cast<std::uint16_t>(bits));
+	}
+	return start(i);
+}
+
+template <typename K>
+auto bitmap_set<K>::seek(size_t c, std::uint32_t low) const
+	-> const_iterator {
+
+	const_iterator it;
+	it.set_ = this;
+	for(; c < chunks_.size(); ++c, low = 0){
+		const chunk &ch = chunks_[c];
+		it.chunk_ = c;
+		switch(ch.kind){
+			case bitmap:
+				for(size_t w = low / 64; w < kBitmapWords; ++w){
+					std::uint64_t word = words_[ch.offset + w];
+					if(w == low / 64) word &= ~std::uint64_t{0} << (low % 64);
+					if(word){
+						it.at_ = w;
+						it.low_ = static_cast<std::uint32_t>(w * 64 + __builtin_ctzll(word));
+						return it;
+					}
+				}
+				break;
+			case runs:
+				for(size_t r = 0; r < ch.count; r += 2){
+					std::uint32_t last = lows_[ch.offset + r + 1];
+					if(low <= last){
+						it.at_ = r;
+						it.low_ = std::max<std::uint32_t>(low, lows_[ch.offset + r]);
+						return it;
+					}
+				}
+				break;
+			default: {
+				auto first = lows_.begin() + ch.offset;
+				auto found = std::lower_bound(first, first + ch.count, low);
+				if(found != first + ch.count){
+					it.at_ = found - first;
+					it.low_ = *found;
+					return it;
+				}
+			}
+		}
+	}
+	return past();
+}
+
+template <typename K>
+void bitmap_set<K>::advance(const_iterator &it) const {
+	const chunk &ch = chunks_[it.chunk_];
+	switch(ch.kind){
+		case bitmap:
+			if(it.low_ + 1 < kChunkValues){
+				// the rest of the current word, then the next nonzero one
+				std::uint64_t word = words_[ch.offset + it.at_] & (~std::uint64_t{1} << (it.low_ % 64));
+				while(!word && ++it.at_ < kBitmapWords) word = words_[ch.offset + it.at_];
+				if(word){
+					it.low_ = static_cast<std::uint32_t>(it.at_ * 64 + __builtin_ctzll(word));
+					return;
+				}
+			}
+			break;
+		case runs:
+			if(it.low_ < lows_[ch.offset + it.at_ + 1]){
+				++it.low_;
+				return;
+			}
+			if(it.at_ + 2 < ch.count){
+				it.at_ += 2;
+				it.low_ = lows_[ch.offset + it.at_];
+				return;
+			}
+			break;
+		default:
+			if(it.at_ + 1 < ch.count){
+				it.low_ = lows_[ch.offset + ++it.at_];
+				return;
+			}
+	}
+	it = start(it.chunk_ + 1);
+}
+
+#endif
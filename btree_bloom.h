@@ -0,0 +1,170 @@
+/**
+ * A blocked Bloom filter, used by the B-Tree to answer most lookups for
+ * absent elements without descending the tree.
+ *
+ * Each key hashes to a single 512-bit block, one cache line, and sets or
+ * tests its k bits within that block, so a negative lookup touches at
+ * most one line of the filter.  Blocking costs a slightly higher false
+ * positive rate than a classic Bloom filter at the same size, which is
+ * why the filter counts its own false positives: the tree reports the
+ * measured rate through btree<T>::stats().
+ *
+ * Keys are hashed with std::hash<T>, remixed so identity hashes (as for
+ * integers) still spread over the blocks.  Types std::hash cannot hash
+ * can still be stored in a btree, but cannot have a filter.
+ */
+
+#ifndef BTREE_BLOOM_H
+#define BTREE_BLOOM_H
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "btree_alloc.h"
+#include "btree_relaxed.h"
+
+/**
+ * Whether std::hash can hash T.
+ */
+template <typename T>
+struct btree_hashable : std::is_default_constructible<std::hash<T>> { };
+
+namespace btree_bloom_detail {
+
+/**
+ * std::hash<T>, finished with the splitmix64 mixer.  For types that
+ * cannot be hashed it returns 0, and is never called at run time.
+ */
+template <typename T, bool = btree_hashable<T>::value>
+struct mixed_hash {
+	std::uint64_t operator()(const T &key) const {
+		std::uint64_t z = static_cast<std::uint64_t>(std::hash<T>()(key));
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+};
+
+template <typename T>
+struct mixed_hash<T, false> {
+	std::uint64_t operator()(const T &) const { return 0; }
+};
+
+}
+
+template <typename T>
+class blocked_bloom {
+	public:
+		static const size_t block_bits = 512;
+
+		/**
+		 * @param capacity the number of keys the filter is sized for
+		 * @param bits_per_key the filter's size per key; about 10 gives
+		 *        a false positive rate near 1%
+		 */
+		blocked_bloom(size_t capacity, double bits_per_key)
+			: capacity_{capacity < 64 ? 64 : capacity}, bitsPerKey_{bits_per_key}, keys_{0}, checks_{0}, negatives_{0}, falsePositives_{0} {
+			if(!(bits_per_key >= 1 && bits_per_key <= 64)){
+				throw std::invalid_argument("bloom filter bits per key must be in [1, 64]");
+			}
+			size_t bits = static_cast<size_t>(std::ceil(capacity_ * bits_per_key));
+			blocks_ = (bits + block_bits - 1) / block_bits;
+			hashes_ = static_cast<unsigned>(std::lround(bits_per_key * std::log(2.0)));
+			hashes_ = hashes_ < 1 ? 1 : hashes_ > 16 ? 16 : hashes_;
+			allocate();
+		}
+
+		blocked_bloom(const blocked_bloom &other)
+			: capacity_{other.capacity_}, bitsPerKey_{other.bitsPerKey_}, blocks_{other.blocks_}, hashes_{other.hashes_},
+			  keys_{other.keys_}, checks_{0}, negatives_{0}, falsePositives_{0} {
+			allocate();
+			std::copy(other.words_, other.words_ + blocks_ * kWordsPerBlock, words_);
+		}
+
+		blocked_bloom& operator=(const blocked_bloom&) = delete;
+
+		void add(const T &key) {
+			std::uint64_t h = hash_(key);
+			std::uint64_t *block = words_ + blockOf(h) * kWordsPerBlock;
+			std::uint32_t h1 = static_cast<std::uint32_t>(h), h2 = static_cast<std::uint32_t>(h >> 32) | 1;
+			for(unsigned i = 0; i < hashes_; ++i){
+				unsigned bit = (h1 + i * h2) % block_bits;
+				block[bit / 64] |= std::uint64_t{1} << (bit % 64);
+			}
+			++keys_;
+		}
+
+		/**
+		 * False means the key was certainly never added.
+		 */
+		bool may_contain(const T &key) const {
+			std::uint64_t h = hash_(key);
+			const std::uint64_t *block = words_ + blockOf(h) * kWordsPerBlock;
+			std::uint32_t h1 = static_cast<std::uint32_t>(h), h2 = static_cast<std::uint32_t>(h >> 32) | 1;
+			btree_relaxed::bump(checks_);
+			for(unsigned i = 0; i < hashes_; ++i){
+				unsigned bit = (h1 + i * h2) % block_bits;
+				if(!(block[bit / 64] & (std::uint64_t{1} << (bit % 64)))){
+					btree_relaxed::bump(negatives_);
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/**
+		 * Records that a key the filter let through was not there.
+		 */
+		void false_positive() const { btree_relaxed::bump(falsePositives_); }
+
+		/**
+		 * Whether more keys have been added than the filter was sized
+		 * for, so it should be rebuilt larger.
+		 */
+		bool overfull() const { return keys_ > capacity_; }
+
+		size_t capacity() const { return capacity_; }
+		double bits_per_key() const { return bitsPerKey_; }
+		size_t bytes() const { return storage_.capacity() * sizeof(std::uint64_t); }
+
+		std::uint64_t checks() const { return checks_.load(std::memory_order_relaxed); }
+		std::uint64_t negatives() const { return negatives_.load(std::memory_order_relaxed); }
+		std::uint64_t false_positives() const { return falsePositives_.load(std::memory_order_relaxed); }
+
+	private:
+		static const size_t kWordsPerBlock = block_bits / 64;
+
+		/**
+		 * Allocates the zeroed blocks, aligned to a cache line within a
+		 * slightly larger buffer.
+		 */
+		void allocate() {
+			storage_.assign(blocks_ * kWordsPerBlock + kWordsPerBlock - 1, 0);
+			auto addr = reinterpret_cast<std::uintptr_t>(storage_.data());
+			size_t skew = (64 - addr % 64) % 64 / sizeof(std::uint64_t);
+			words_ = storage_.data() + skew;
+		}
+
+		size_t blockOf(std::uint64_t h) const {
+			// the high bits pick the block, the low bits the bits within it
+			return static_cast<size_t>((static_cast<unsigned __int128>(h >> 32) * blocks_) >> 32);
+		}
+
+		size_t capacity_;
+		double bitsPerKey_;
+		size_t blocks_;
+		unsigned hashes_;
+		size_t keys_;
+		std::vector<std::uint64_t, btree_allocator<std::uint64_t>> storage_;
+		std::uint64_t *words_;
+		btree_bloom_detail::mixed_hash<T> hash_;
+		mutable std::atomic<std::uint64_t> checks_, negatives_, falsePositives_;
+};
+
+#endif
@@ -0,0 +1,187 @@
+/**
+ * Optional hot-path counters for the B-Tree.
+ *
+ * Building with BTREE_HOT_COUNTERS defined makes the tree count the key
+ * comparisons made while descending, the nodes visited by each find and
+ * insert, the parent climbs made by iterators and the nodes allocated.
+ * Without it the counting macros expand to nothing and the tree compiles
+ * exactly as before.
+ *
+ * Each thread counts into its own block, so counting is a plain
+ * increment with no sharing between threads.  btree_counters::snapshot()
+ * sums the blocks of every thread, including threads that have exited,
+ * and btree_counters::reset() zeroes them.
+ */
+
+#ifndef BTREE_COUNTERS_H
+#define BTREE_COUNTERS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "btree_relaxed.h"
+
+template <typename U>
+struct basic_btree_counters {
+	U comparisons;       // key comparisons made while descending the tree
+	U node_visits;       // nodes visited while descending the tree
+	U finds;             // calls to find
+	U find_visits;       // nodes visited by those finds
+	U inserts;           // calls to insert
+	U insert_visits;     // nodes visited by those inserts
+	U parent_climbs;     // iterator steps from a node up to its parent
+	U node_allocations;  // nodes made in a tree, by insert or by copying
+};
+
+using btree_hot_counters = basic_btree_counters<std::uint64_t>;
+
+namespace btree_counters {
+
+namespace detail {
+
+using block = basic_btree_counters<std::atomic<std::uint64_t>>;
+
+template <typename To, typename From>
+void accumulate(To &to, const From &from) {
+	auto add = [](std::uint64_t &into, const std::atomic<std::uint64_t> &value) {
+		into += value.load(std::memory_order_relaxed);
+	};
+	add(to.comparisons, from.comparisons);
+	add(to.node_visits, from.node_visits);
+	add(to.finds, from.finds);
+	add(to.find_visits, from.find_visits);
+	add(to.inserts, from.inserts);
+	add(to.insert_visits, from.insert_visits);
+	add(to.parent_climbs, from.parent_climbs);
+	add(to.node_allocations, from.node_allocations);
+}
+
+inline void clear(block &b) {
+	for(auto *field : {&b.comparisons, &b.node_visits, &b.finds, &b.find_visits,
+			&b.inserts, &b.insert_visits, &b.parent_climbs, &b.node_allocations}){
+		field->store(0, std::memory_order_relaxed);
+	}
+}
+
+/**
+ * Every live thread's block, plus the totals of threads that exited.
+ */
+struct registry {
+	std::mutex mutex;
+	std::vector<block*> live;
+	block retired;
+
+	registry() { clear(retired); }
+};
+
+inline registry& global() {
+	static registry r;
+	return r;
+}
+
+/**
+ * A thread's block, which registers itself on first use and folds its
+ * counts into the retired totals when the thread exits.
+ */
+struct thread_block {
+	block counters;
+
+	thread_block() {
+		clear(counters);
+		std::lock_guard<std::mutex> lock(global().mutex);
+		global().live.push_back(&counters);
+	}
+
+	~thread_block() {
+		registry &r = global();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		btree_hot_counters mine{};
+		accumulate(mine, counters);
+		auto fold = [](std::atomic<std::uint64_t> &into, std::uint64_t value) {
+			into.store(into.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		};
+		fold(r.retired.comparisons, mine.comparisons);
+		fold(r.retired.node_visits, mine.node_visits);
+		fold(r.retired.finds, mine.finds);
+		fold(r.retired.find_visits, mine.find_visits);
+		fold(r.retired.inserts, mine.inserts);
+		fold(r.retired.insert_visits, mine.insert_visits);
+		fold(r.retired.parent_climbs, mine.parent_climbs);
+		fold(r.retired.node_allocations, mine.node_allocations);
+		r.live.erase(std::find(r.live.begin(), r.live.end(), &counters));
+	}
+};
+
+}
+
+/**
+ * The calling thread's counters.  Only the owning thread writes them,
+ * so a relaxed load and store is enough to bump one.
+ */
+inline detail::block& local() {
+	thread_local detail::thread_block b;
+	return b.counters;
+}
+
+using btree_relaxed::bump;
+
+/**
+ * The totals over every thread that has counted anything.
+ */
+inline btree_hot_counters snapshot() {
+	detail::registry &r = detail::global();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	btree_hot_counters total{};
+	detail::accumulate(total, r.retired);
+	for(auto *b : r.live){
+		detail::accumulate(total, *b);
+	}
+	return total;
+}
+
+/**
+ * Zeroes the counters of every thread.  Counts made concurrently with
+ * the reset may survive it.
+ */
+inline void reset() {
+	detail::registry &r = detail::global();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	detail::clear(r.retired);
+	for(auto *b : r.live){
+		detail::clear(*b);
+	}
+}
+
+/**
+ * Attributes the node visits made during its lifetime to one counter,
+ * so a find or insert can tell its share of the descent apart.
+ */
+class visit_scope {
+	public:
+		explicit visit_scope(std::atomic<std::uint64_t> detail::block::*field)
+			: field_{field}, start_{local().node_visits.load(std::memory_order_relaxed)} { }
+
+		~visit_scope() {
+			detail::block &b = local();
+			bump(b.*field_, b.node_visits.load(std::memory_order_relaxed) - start_);
+		}
+
+	private:
+		std::atomic<std::uint64_t> detail::block::*field_;
+		std::uint64_t start_;
+};
+
+}
+
+#ifdef BTREE_HOT_COUNTERS
+#define BTREE_COUNT(field) btree_counters::bump(btree_counters::local().field)
+#define BTREE_COUNT_VISITS(field) btree_counters::visit_scope btree_visit_scope_(&btree_counters::detail::block::field)
+#else
+#define BTREE_COUNT(field) ((void)0)
+#define BTREE_COUNT_VISITS(field) ((void)0)
+#endif
+
+#endif
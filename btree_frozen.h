@@ -0,0 +1,264 @@
+/**
+ * A frozen, read-only snapshot of a B-Tree, made by btree<T>::freeze().
+ *
+ * The elements are laid out in a single array in Eytzinger order: the
+ * implicit binary search tree whose root is at position 1 and whose
+ * node k has children 2k and 2k + 1.  There are no pointers to chase,
+ * the first levels of every search share the same few cache lines, and
+ * the search loop has no data-dependent branch: each step moves to
+ * 2k + (element < key), and the answer is recovered at the end from the
+ * bits of k.  While comparing at k the search prefetches the cache line
+ * holding k's descendants four levels down, so memory latency overlaps
+ * with the comparisons.
+ *
+ * Ordered iteration walks the implicit tree in order with bit tricks, so
+ * a frozen tree supports find, lower_bound and both directions of
+ * iteration.  thaw() builds a mutable btree again, inserting elements in
+ * an order that fills every node before its children, so the result is
+ * as shallow as the node size allows whatever order the original was
+ * built in.
+ */
+
+#ifndef BTREE_FROZEN_H
+#define BTREE_FROZEN_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "btree_alloc.h"
+
+template <typename T> class btree;
+
+template <typename T>
+class frozen_btree {
+	public:
+		class const_iterator {
+			public:
+				typedef std::ptrdiff_t difference_type;
+				typedef std::bidirectional_iterator_tag iterator_category;
+				typedef const T value_type;
+				typedef const T* pointer;
+				typedef const T& reference;
+
+				const_iterator() : tree_{nullptr}, k_{0} { }
+
+				reference operator*() const { return tree_->at(k_); }
+				pointer operator->() const { return &(operator*()); }
+
+				bool operator==(const const_iterator &other) const { return k_ == other.k_; }
+				bool operator!=(const const_iterator &other) const { return k_ != other.k_; }
+
+				const_iterator& operator++() {
+					k_ = next(k_, tree_->size());
+					return *this;
+				}
+
+				const_iterator operator++(int) {
+					auto copy = *this;
+					operator++();
+					return copy;
+				}
+
+				const_iterator& operator--() {
+					k_ = prev(k_, tree_->size());
+					return *this;
+				}
+
+				const_iterator operator--(int) {
+					auto copy = *this;
+					operator--();
+					return copy;
+				}
+
+			private:
+				friend class frozen_btree;
+
+				const_iterator(const frozen_btree *tree, size_t k) : tree_{tree}, k_{k} { }
+
+				const frozen_btree *tree_;
+				size_t k_;              // position in the implicit tree, 0 past the end
+		};
+
+		using iterator = const_iterator;
+		using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+		using reverse_iterator = const_reverse_iterator;
+
+		/**
+		 * An empty frozen tree; real ones come from btree<T>::freeze().
+		 */
+		frozen_btree() = default;
+
+		/**
+		 * Freezes the elements of a sorted range.
+		 *
+		 * @param first, last a range of distinct elements in ascending
+		 *        order, readable in several passes
+		 */
+		template <typename ForwardIt>
+		frozen_btree(ForwardIt first, ForwardIt last);
+
+		size_t size() const { return data_.size(); }
+		bool empty() const { return data_.empty(); }
+
+		/**
+		 * Heap bytes held by the snapshot, excluding anything the
+		 * elements themselves allocate.
+		 */
+		size_t bytes() const { return data_.capacity() * sizeof(T); }
+
+		const_iterator begin() const { return {this, leftmost(1, size())}; }
+		const_iterator end() const { return {this, 0}; }
+		const_iterator cbegin() const { return begin(); }
+		const_iterator cend() const { return end(); }
+		const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+		const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+		const_reverse_iterator crbegin() const { return rbegin(); }
+		const_reverse_iterator crend() const { return rend(); }
+
+		/**
+		 * The first element not less than elem, or end().
+		 */
+		const_iterator lower_bound(const T& elem) const;
+
+		/**
+		 * The matching element, or end() if there is none.
+		 */
+		const_iterator find(const T& elem) const {
+			auto it = lower_bound(elem);
+			return it != end() && *it == elem ? it : end();
+		}
+
+		bool contains(const T& elem) const { return find(elem) != end(); }
+
+		/**
+		 * Builds a mutable btree holding the same elements, with every
+		 * node full before any of its children is made.
+		 *
+		 * @param maxNodeElems the node size of the new tree; a tree of
+		 * nodes with no room still puts one element in each
+		 */
+		btree<T> thaw(size_t maxNodeElems = 40) const;
+
+	private:
+		// elements this many positions past k hold k's descendants four
+		// levels down, so one prefetch covers them
+		static const size_t kPrefetchLevels = 4;
+
+		const T& at(size_t k) const { return data_[k - 1]; }
+
+		/**
+		 * Steps around the implicit tree of n elements; position 0 is
+		 * past the end.
+		 */
+		static size_t leftmost(size_t k, size_t n) {
+			if(k > n) return 0;
+			while(2 * k <= n) k = 2 * k;
+			return k;
+		}
+
+		static size_t rightmost(size_t k, size_t n) {
+			if(k > n) return 0;
+			while(2 * k + 1 <= n) k = 2 * k + 1;
+			return k;
+		}
+
+		static size_t next(size_t k, size_t n) {
+			if(2 * k + 1 <= n) return leftmost(2 * k + 1, n);
+			// climb while k is a right child, then once more
+			return k >> (countTrailingOnes(k) + 1);
+		}
+
+		static size_t prev(size_t k, size_t n) {
+			if(k == 0) return rightmost(1, n);
+			if(2 * k <= n) return rightmost(2 * k, n);
+			// climb while k is a left child, then once more
+			return k >> (countTrailingOnes(~k) + 1);
+		}
+
+		static unsigned countTrailingOnes(size_t k) {
+			return static_cast<unsigned>(__builtin_ctzll(~static_cast<unsigned long long>(k)));
+		}
+
+		static void thawRange(btree<T> &tree, const T* const *sorted, size_t count, size_t maxNodeElems);
+
+		std::vector<T, btree_allocator<T>> data_;
+};
+
+template <typename T>
+template <typename ForwardIt>
+frozen_btree<T>::frozen_btree(ForwardIt first, ForwardIt last) {
+	std::vector<const T*> sorted;
+	for(auto it = first; it != last; ++it) sorted.push_back(&*it);
+
+	// the rank of each position, found by walking the implicit tree in
+	// order, then the elements in position order
+	const size_t n = sorted.size();
+	std::vector<size_t> rank(n);
+	size_t i = 0;
+	for(size_t k = leftmost(1, n); k; k = next(k, n)) rank[k - 1] = i++;
+
+	data_.reserve(n);
+	for(size_t j = 0; j < n; ++j) data_.push_back(*sorted[rank[j]]);
+}
+
+template <typename T>
+auto frozen_btree<T>::lower_bound(const T& elem) const
+	-> const_iterator {
+
+	const size_t n = data_.size();
+	const T *base = data_.data();
+	size_t k = 1;
+	while(k <= n){
+		__builtin_prefetch(base + std::min(k << kPrefetchLevels, n) - 1);
+		k = 2 * k + (base[k - 1] < elem);
+	}
+	// k went right after the answer, then left down to a leaf's child
+	k >>= countTrailingOnes(k) + 1;
+	return {this, k};
+}
+
+template <typename T>
+btree<T> frozen_btree<T>::thaw(size_t maxNodeElems) const {
+	std::vector<const T*> sorted;
+	sorted.reserve(size());
+	for(const auto &elem : *this) sorted.push_back(&elem);
+
+	btree<T> tree(maxNodeElems);
+	thawRange(tree, sorted.data(), sorted.size(), maxNodeElems ? maxNodeElems : 1);
+	return tree;
+}
+
+template <typename T>
+void frozen_btree<T>::thawRange(btree<T> &tree, const T* const *sorted, size_t count, size_t maxNodeElems) {
+	if(count <= maxNodeElems){
+		for(size_t i = 0; i < count; ++i) tree.insert(*sorted[i]);
+		return;
+	}
+
+	// maxNodeElems separators fill this node and the rest go to its
+	// children, each filled to the smallest full subtree that leaves room
+	// for everything, from the left, so only the rightmost are partial
+	size_t rest = count - maxNodeElems, child = maxNodeElems;
+	while(child * (maxNodeElems + 1) < rest) child = child * (maxNodeElems + 1) + maxNodeElems;
+
+	size_t pos = 0, left = rest;
+	for(size_t i = 0; i < maxNodeElems; ++i){
+		size_t gap = std::min(child, left);
+		pos += gap;
+		left -= gap;
+		tree.insert(*sorted[pos++]);
+	}
+	pos = 0;
+	left = rest;
+	for(size_t i = 0; i <= maxNodeElems; ++i){
+		size_t gap = std::min(child, left);
+		thawRange(tree, sorted + pos, gap, maxNodeElems);
+		pos += gap + 1;
+		left -= gap;
+	}
+}
+
+#endif
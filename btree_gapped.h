@@ -0,0 +1,532 @@
+/**
+ * The element storage of a btree node: a fixed number of slots, sorted,
+ * with gaps left between elements while the node fills, in the manner
+ * of a packed-memory array.
+ *
+ * A dense array makes every insert shift, on average, half the node's
+ * elements one place along; for std::string or any large T those moves
+ * dominate the insert.  Here an element lands in a free slot between
+ * its neighbours when there is one, and otherwise the shorter run of
+ * elements between it and the nearest gap, on either side, moves one
+ * place.  Only when that gap is more than twice the average distance
+ * between gaps away, so that the node is locally too dense, are its
+ * elements spread out again, evenly over the first slots with one gap
+ * after each.
+ *
+ * A full node has no gaps, so its slots are exactly its elements in
+ * order, which is all a node with children ever is.  Every slot index
+ * here is physical: an element's slot is where it sits, and the gaps of
+ * a node still filling are skipped with a bitmap of occupied slots.
+ *
+ * Gaps cost reads: a search of a node still filling probes the bitmap,
+ * and a scan skips gaps one bitmap lookup at a time.  Nodes are dense
+ * unless the tree is built with BTREE_GAPPED_NODES defined; btree_dense
+ * below is the same interface over a plain sorted array.
+ */
+
+#ifndef BTREE_GAPPED_H
+#define BTREE_GAPPED_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "btree_alloc.h"
+
+/**
+ * The default element storage of a btree node: the elements in order with
+ * no gaps, so slot i is the element of rank i and slots() is size().
+ */
+template <typename T>
+class btree_dense {
+	public:
+		explicit btree_dense(size_t capacity) { values_.reserve(capacity); }
+
+		size_t size() const { return values_.size(); }
+		size_t slots() const { return values_.size(); }
+		size_t capacity() const { return values_.capacity(); }
+		bool empty() const { return values_.empty(); }
+		bool occupied(size_t slot) const { return slot < values_.size(); }
+
+		T& operator[](size_t slot) { return values_[slot]; }
+		const T& operator[](size_t slot) const { return values_[slot]; }
+		T& at(size_t slot) { return values_.at(slot); }
+		const T& at(size_t slot) const { return values_.at(slot); }
+
+		size_t first() const { return 0; }
+		size_t next(size_t slot) const { return slot + 1; }
+		size_t prev(size_t slot) const { return slot - 1; }
+
+		const T& front() const { return values_.front(); }
+		const T& back() const { return values_.back(); }
+
+		template <typename Less>
+		size_t lower_bound(const T& elem, Less less) const {
+			return std::lower_bound(values_.begin(), values_.end(), elem, less) - values_.begin();
+		}
+		size_t lower_bound(const T& elem) const { return std::lower_bound(values_.begin(), values_.end(), elem) - values_.begin(); }
+
+		/**
+		 * Adds elem at slot before, moving each element after it once.
+		 */
+		size_t insert(size_t before, const T& elem) {
+			values_.insert(values_.begin() + before, elem);
+			return before;
+		}
+
+		void copy(const btree_dense &other) { values_.insert(values_.end(), other.values_.begin(), other.values_.end()); }
+
+		/**
+		 * Replaces the elements with other's, assigning over those here
+		 * if the storage has the same capacity, and reallocating to
+		 * other's capacity if not.
+		 */
+		void assign(const btree_dense &other) {
+			if(values_.capacity() != other.values_.capacity()){
+				decltype(values_) fresh;
+				fresh.reserve(other.values_.capacity());
+				values_.swap(fresh);
+			}
+			values_.assign(other.values_.begin(), other.values_.end());
+		}
+
+		/**
+		 * Moves every element into roomier, which must be empty with at
+		 * least as much room, leaving this empty.
+		 */
+		void move_to(btree_dense &roomier) {
+			roomier.values_.insert(roomier.values_.end(), std::make_move_iterator(values_.begin()), std::make_move_iterator(values_.end()));
+			values_.clear();
+		}
+
+		void swap(btree_dense &other) { values_.swap(other.values_); }
+
+		/**
+		 * Makes room for at least capacity elements.
+		 */
+		void reserve(size_t capacity) { values_.reserve(capacity); }
+
+		size_t bytes() const { return values_.capacity() * sizeof(T); }
+
+	private:
+		std::vector<T, btree_allocator<T>> values_;
+};
+
+template <typename T>
+class btree_gapped {
+	static_assert(alignof(T) <= alignof(std::max_align_t), "btree_gapped cannot over-align its slots");
+
+	public:
+		/**
+		 * Empty storage for the given number of slots, at most 65535.
+		 */
+		explicit btree_gapped(size_t slots);
+		~btree_gapped();
+
+		btree_gapped(const btree_gapped&) = delete;
+		btree_gapped& operator=(const btree_gapped&) = delete;
+
+		/**
+		 * Takes other's slots, leaving it with none.
+		 */
+		btree_gapped(btree_gapped &&other) noexcept : data_{other.data_}, size_{other.size_}, slots_{other.slots_} {
+			other.data_ = nullptr;
+			other.size_ = other.slots_ = 0;
+		}
+
+		size_t size() const { return size_; }
+		size_t slots() const { return slots_; }
+		size_t capacity() const { return slots_; }
+		bool empty() const { return size_ == 0; }
+		bool full() const { return size_ == slots_; }
+
+		// a full node needs no look at the bitmap
+		bool occupied(size_t slot) const { return slot < slots_ && (full() || (words()[slot / 64] >> (slot % 64) & 1)); }
+
+		T& operator[](size_t slot) { return data_[slot]; }
+		const T& operator[](size_t slot) const { return data_[slot]; }
+
+		T& at(size_t slot) {
+			if(!occupied(slot)) throw std::out_of_range("btree_gapped: empty slot");
+			return data_[slot];
+		}
+		const T& at(size_t slot) const { return const_cast<btree_gapped*>(this)->at(slot); }
+
+		/**
+		 * The first element's slot, or slots() when empty.
+		 */
+		size_t first() const { return full() ? 0 : next_from(0); }
+
+		/**
+		 * The slot of the element after, or before, the one in slot;
+		 * slots() when there is none after.
+		 */
+		size_t next(size_t slot) const { return full() ? slot + 1 : next_from(slot + 1); }
+		size_t prev(size_t slot) const { return full() ? slot - 1 : prev_before(slot); }
+
+		const T& front() const { return data_[first()]; }
+		const T& back() const { return data_[prev(slots_)]; }
+
+		/**
+		 * The slot of the first element not less than elem, or slots().
+		 */
+		template <typename Less>
+		size_t lower_bound(const T& elem, Less less) const;
+		size_t lower_bound(const T& elem) const { return lower_bound(elem, [](const T& a, const T& b) { return a < b; }); }
+
+		/**
+		 * Adds elem, which must not be present, and returns its slot.
+		 * Elements may move to make room, so slots from before are stale.
+		 *
+		 * @param before the slot lower_bound returned for elem
+		 */
+		size_t insert(size_t before, const T& elem);
+
+		/**
+		 * Copies every element of other into the same slot here; this
+		 * must be empty, with at least as many slots.
+		 */
+		void copy(const btree_gapped &other);
+
+		/**
+		 * Replaces the elements with other's, copied into the same slots:
+		 * the storage is kept if it has as many slots, and otherwise
+		 * reallocated to other's count, so a full node stays gapless.
+		 */
+		void assign(const btree_gapped &other);
+
+		/**
+		 * Destroys every element, keeping the slots.
+		 */
+		void clear();
+
+		/**
+		 * Grows to the given number of slots, if more than now.  Every
+		 * element keeps its slot, so the new slots are all at the end.
+		 */
+		void reserve(size_t slots);
+
+		/**
+		 * Moves every element into the same slot of roomier, which must
+		 * be empty with at least as many slots, leaving this empty.
+		 */
+		void move_to(btree_gapped &roomier);
+
+		void swap(btree_gapped &other) {
+			std::swap(data_, other.data_);
+			std::swap(size_, other.size_);
+			std::swap(slots_, other.slots_);
+		}
+
+		/**
+		 * Heap bytes held, for the slots and the bitmap.
+		 */
+		size_t bytes() const { return storage(slots_); }
+
+	private:
+		static size_t word_count(size_t slots) { return (slots + 63) / 64; }
+		static size_t map_bytes(size_t slots) { return (word_count(slots) * 8 + alignof(T) - 1) / alignof(T) * alignof(T); }
+		static size_t storage(size_t slots) { return map_bytes(slots) + slots * sizeof(T); }
+
+		// the bitmap comes just before the slots in the same block, so a
+		// search of a node still filling, whose elements sit in its first
+		// slots, reads both from the same few cache lines
+		std::uint64_t* words() const {
+			return reinterpret_cast<std::uint64_t*>(reinterpret_cast<char*>(data_) - map_bytes(slots_));
+		}
+
+		void mark(size_t slot) { words()[slot / 64] |= std::uint64_t{1} << (slot % 64); }
+		void unmark(size_t slot) { words()[slot / 64] &= ~(std::uint64_t{1} << (slot % 64)); }
+
+		size_t next_from(size_t slot) const;
+		size_t prev_before(size_t slot) const;
+
+		// moves the element in slot from to the empty slot to
+		void move(size_t from, size_t to) {
+			new (data_ + to) T(std::move(data_[from]));
+			data_[from].~T();
+			unmark(from);
+			mark(to);
+		}
+
+		// elements that are trivially copyable move as bytes, in one block
+		using trivial = std::integral_constant<bool, std::is_trivially_copyable<T>::value>;
+
+		/**
+		 * Moves the elements in slots [from, to) one slot down, into the
+		 * gap at from - 1, or one slot up, into the gap at to, and frees
+		 * the slot left at the other end.
+		 */
+		void shift_down(size_t from, size_t to) {
+			shift_down(from, to, trivial());
+			mark(from - 1);
+			unmark(to - 1);
+		}
+		void shift_up(size_t from, size_t to) {
+			shift_up(from, to, trivial());
+			mark(to);
+			unmark(from);
+		}
+
+		void shift_down(size_t from, size_t to, std::true_type) {
+			std::memmove(data_ + from - 1, data_ + from, (to - from) * sizeof(T));
+		}
+		void shift_down(size_t from, size_t to, std::false_type) {
+			for(size_t s = from; s < to; ++s){
+				new (data_ + s - 1) T(std::move(data_[s]));
+				data_[s].~T();
+			}
+		}
+		void shift_up(size_t from, size_t to, std::true_type) {
+			std::memmove(data_ + from + 1, data_ + from, (to - from) * sizeof(T));
+		}
+		void shift_up(size_t from, size_t to, std::false_type) {
+			for(size_t s = to; s > from; --s){
+				new (data_ + s) T(std::move(data_[s - 1]));
+				data_[s - 1].~T();
+			}
+		}
+
+		void copy(const btree_gapped &other, std::true_type);
+		void copy(const btree_gapped &other, std::false_type);
+		void take(btree_gapped &other, std::true_type) { copy(other, std::true_type()); }
+		void take(btree_gapped &other, std::false_type);
+		void destroy(std::true_type) { }
+		void destroy(std::false_type) {
+			for(size_t s = first(); s < slots_; s = next(s)) data_[s].~T();
+		}
+
+		size_t spread(size_t before);
+
+		T *data_;
+		std::uint32_t size_;
+		std::uint32_t slots_;
+};
+
+template <typename T>
+btree_gapped<T>::btree_gapped(size_t slots)
+	: data_{reinterpret_cast<T*>(static_cast<char*>(btree_alloc::allocate(storage(slots))) + map_bytes(slots))},
+	  size_{0}, slots_{static_cast<std::uint32_t>(slots)} {
+	std::fill(words(), words() + word_count(slots_), 0);
+}
+
+template <typename T>
+btree_gapped<T>::~btree_gapped() {
+	// storage moved away leaves nothing to free
+	if(!data_) return;
+	destroy(trivial());
+	btree_alloc::deallocate(words(), storage(slots_));
+}
+
+template <typename T>
+inline size_t btree_gapped<T>::next_from(size_t slot) const {
+	const std::uint64_t *w = words();
+	size_t i = slot / 64, count = word_count(slots_);
+	if(i >= count) return slots_;
+	std::uint64_t bits = w[i] & (~std::uint64_t{0} << (slot % 64));
+	while(!bits){
+		if(++i == count) return slots_;
+		bits = w[i];
+	}
+	return i * 64 + __builtin_ctzll(bits);
+}
+
+template <typename T>
+inline size_t btree_gapped<T>::prev_before(size_t slot) const {
+	// the caller guarantees an element before slot
+	const std::uint64_t *w = words();
+	size_t i = (slot - 1) / 64;
+	std::uint64_t bits = w[i] & (~std::uint64_t{0} >> (63 - (slot - 1) % 64));
+	while(!bits) bits = w[--i];
+	return i * 64 + 63 - __builtin_clzll(bits);
+}
+
+template <typename T>
+template <typename Less>
+size_t btree_gapped<T>::lower_bound(const T& elem, Less less) const {
+	if(full()) return std::lower_bound(data_, data_ + slots_, elem, less) - data_;
+
+	// the first slot whose next element is not less than elem; moving
+	// the slot right only moves its next element right, so this is
+	// monotone and a binary search over the slots finds it.  Probes in
+	// a gap before the element already found need no comparison.
+	if(empty()) return slots_;
+	size_t lo = 0, hi = prev_before(slots_) + 1, found = slots_;
+	while(lo < hi){
+		size_t mid = lo + (hi - lo) / 2;
+		size_t at = next_from(mid);
+		if(at == found || !less(data_[at], elem)){
+			found = at;
+			hi = mid;
+		}
+		else{
+			lo = at + 1;
+		}
+	}
+	return found;
+}
+
+template <typename T>
+size_t btree_gapped<T>::insert(size_t before, const T& elem) {
+	assert(!full());
+
+	// the free slots, if any, between elem's neighbours
+	bool hasPrev = size_ != 0 && first() < before;
+	size_t gapStart = hasPrev ? prev_before(before) + 1 : 0;
+
+	size_t slot;
+	if(gapStart < before){
+		// free slots between the neighbours: prepends take the last and
+		// inserts between two elements the middle; appends, and the first
+		// element, take the first, so ascending inserts never move one
+		bool hasNext = before < slots_;
+		if(!hasNext) slot = gapStart;
+		else if(!hasPrev) slot = before - 1;
+		else slot = gapStart + (before - gapStart) / 2;
+	}
+	else{
+		// the nearest gap on either side, and how far the elements
+		// between would have to move
+		size_t left = slots_, right = slots_;
+		for(size_t s = before; s-- > 0; ){
+			if(!occupied(s)){
+				left = s;
+				break;
+			}
+		}
+		for(size_t s = before; s < slots_; ++s){
+			if(!occupied(s)){
+				right = s;
+				break;
+			}
+		}
+		size_t leftCost = left < slots_ ? before - 1 - left : slots_, rightCost = right < slots_ ? right - before : slots_;
+		size_t gaps = slots_ - size_;
+		if(std::min(leftCost, rightCost) > 2 * slots_ / gaps){
+			slot = spread(before);
+		}
+		else if(leftCost <= rightCost){
+			shift_down(left + 1, before);
+			slot = before - 1;
+		}
+		else{
+			shift_up(before, right);
+			slot = before;
+		}
+	}
+
+	new (data_ + slot) T(elem);
+	mark(slot);
+	++size_;
+	return slot;
+}
+
+template <typename T>
+size_t btree_gapped<T>::spread(size_t before) {
+	// element i of the size_ + 1, counting the one to come, goes to
+	// slot i * span / (size_ + 1), leaving about one gap an element: a
+	// node barely filled stays in the few cache lines a dense one would
+	// use.  Those moving left go first, left to right, and those moving
+	// right after, right to left, so no element lands on one that has
+	// yet to move.
+	size_t total = size_ + 1;
+	size_t span = 2 * total < slots_ ? 2 * total : slots_;
+	auto target = [span, total](size_t i) { return i * span / total; };
+
+	size_t newRank = 0;
+	for(size_t s = first(); s < before; s = next(s)) ++newRank;
+
+	size_t i = 0;
+	for(size_t s = first(); s < slots_; ){
+		size_t nextSlot = next(s);
+		size_t to = target(i < newRank ? i : i + 1);
+		if(to < s) move(s, to);
+		++i;
+		s = nextSlot;
+	}
+	size_t s = slots_;
+	for(i = size_; i-- > 0; ){
+		s = prev_before(s);
+		size_t to = target(i < newRank ? i : i + 1);
+		if(to > s) move(s, to);
+	}
+	return target(newRank);
+}
+
+template <typename T>
+void btree_gapped<T>::copy(const btree_gapped &other) {
+	copy(other, trivial());
+}
+
+template <typename T>
+void btree_gapped<T>::take(btree_gapped &other, std::false_type) {
+	for(size_t s = other.first(); s < other.slots_; s = other.next(s)){
+		new (data_ + s) T(std::move(other.data_[s]));
+		mark(s);
+		++size_;
+	}
+}
+
+template <typename T>
+void btree_gapped<T>::reserve(size_t slots) {
+	if(slots <= slots_) return;
+	btree_gapped grown(slots);
+	grown.take(*this, trivial());
+	// grown is left with the old block, and frees it
+	std::swap(data_, grown.data_);
+	std::swap(slots_, grown.slots_);
+}
+
+template <typename T>
+void btree_gapped<T>::move_to(btree_gapped &roomier) {
+	roomier.take(*this, trivial());
+	clear();
+}
+
+template <typename T>
+void btree_gapped<T>::assign(const btree_gapped &other) {
+	if(slots_ == other.slots_){
+		clear();
+	}
+	else{
+		// fresh is left with the old block, and frees it
+		btree_gapped fresh(other.slots_);
+		swap(fresh);
+	}
+	copy(other);
+}
+
+template <typename T>
+void btree_gapped<T>::clear() {
+	destroy(trivial());
+	std::fill(words(), words() + word_count(slots_), 0);
+	size_ = 0;
+}
+
+template <typename T>
+void btree_gapped<T>::copy(const btree_gapped &other, std::true_type) {
+	// the bitmap and every slot up to the last element, gaps and all
+	size_t used = other.empty() ? 0 : other.prev(other.slots_) + 1;
+	std::memcpy(words(), other.words(), word_count(other.slots_) * 8);
+	std::memcpy(data_, other.data_, used * sizeof(T));
+	size_ = other.size_;
+}
+
+template <typename T>
+void btree_gapped<T>::copy(const btree_gapped &other, std::false_type) {
+	for(size_t s = other.first(); s < other.slots_; s = other.next(s)){
+		new (data_ + s) T(other.data_[s]);
+		mark(s);
+		++size_;
+	}
+}
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ * A hash side-index for the B-Tree, mapping each element to the node
+ * holding it and its slot there, so a find can skip the descent.
+ *
+ * Nodes never move or split, so the node an element lands in is fixed
+ * for the element's lifetime; only its slot can change, as other
+ * elements are inserted into a node that is not yet full.  The slot is
+ * therefore kept as a hint: a lookup checks the element at the hinted
+ * slot first and falls back to a binary search of that one node.  Most
+ * elements live in full nodes, which never change, so most hints hold.
+ * Hints are not repaired by lookups, keeping const finds free of writes
+ * to shared state.
+ *
+ * The table is open-addressed with linear probing.  Each entry is a node
+ * pointer, a slot and 32 bits of the element's hash, which both filters
+ * probes and picks the entry's bucket, so growing the table never needs
+ * to rehash the elements themselves.
+ */
+
+#ifndef BTREE_HASH_INDEX_H
+#define BTREE_HASH_INDEX_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "btree_alloc.h"
+#include "btree_bloom.h"
+#include "btree_relaxed.h"
+
+/**
+ * @param T the element type, hashable by std::hash
+ * @param Node the tree's node type, whose values_ hold the elements in
+ * a btree_dense or btree_gapped
+ */
+template <typename T, typename Node>
+class btree_hash_index {
+	public:
+		explicit btree_hash_index(size_t expected)
+			: bits_{4}, size_{0}, updates_{0}, lookups_{0}, staleHints_{0} {
+			while((size_t{1} << bits_) * 3 / 4 < expected && bits_ < 32) ++bits_;
+			table_.resize(size_t{1} << bits_);
+		}
+
+		btree_hash_index(const btree_hash_index&) = delete;
+		btree_hash_index& operator=(const btree_hash_index&) = delete;
+
+		/**
+		 * Indexes an element that is not yet in the index.
+		 */
+		void add(const T &key, Node *at, size_t slot) {
+			if((size_ + 1) > table_.size() * 3 / 4 && bits_ < 32) grow();
+			place({at, static_cast<std::uint32_t>(slot), tag(key)});
+			++size_;
+			++updates_;
+		}
+
+		/**
+		 * The node and slot holding an element, or a null node if it is
+		 * not indexed.
+		 */
+		std::pair<Node*, size_t> find(const T &key) const {
+			std::uint32_t t = tag(key);
+			size_t mask = table_.size() - 1;
+			btree_relaxed::bump(lookups_);
+			for(size_t i = bucket(t); table_[i].at; i = (i + 1) & mask){
+				const entry &e = table_[i];
+				if(e.tag != t) continue;
+
+				const auto &values = e.at->values_;
+				if(values.occupied(e.slot) && values[e.slot] == key){
+					return {e.at, e.slot};
+				}
+				size_t lower = values.lower_bound(key);
+				if(lower < values.slots() && values[lower] == key){
+					btree_relaxed::bump(staleHints_);
+					return {e.at, lower};
+				}
+			}
+			return {nullptr, 0};
+		}
+
+		size_t size() const { return size_; }
+		size_t bytes() const { return table_.capacity() * sizeof(entry); }
+
+		/**
+		 * Elements the table holds before it next grows.
+		 */
+		size_t capacity() const { return table_.size() * 3 / 4; }
+
+		/**
+		 * Entries written, by adds and by moves as the table grows.
+		 */
+		std::uint64_t updates() const { return updates_; }
+		std::uint64_t lookups() const { return lookups_.load(std::memory_order_relaxed); }
+		std::uint64_t stale_hints() const { return staleHints_.load(std::memory_order_relaxed); }
+
+	private:
+		struct entry {
+			Node *at;             // null for an empty bucket
+			std::uint32_t slot;   // where the element was when indexed
+			std::uint32_t tag;    // the high half of the element's hash
+		};
+
+		std::uint32_t tag(const T &key) const {
+			return static_cast<std::uint32_t>(hash_(key) >> 32);
+		}
+
+		size_t bucket(std::uint32_t t) const {
+			return bits_ ? t >> (32 - bits_) : 0;
+		}
+
+		void place(const entry &e) {
+			size_t mask = table_.size() - 1;
+			size_t i = bucket(e.tag);
+			while(table_[i].at) i = (i + 1) & mask;
+			table_[i] = e;
+		}
+
+		void grow() {
+			std::vector<entry, btree_allocator<entry>> old(size_t{2} << bits_);
+			old.swap(table_);
+			++bits_;
+			for(const auto &e : old){
+				if(e.at){
+					place(e);
+					++updates_;
+				}
+			}
+		}
+
+		unsigned bits_;
+		size_t size_;
+		std::uint64_t updates_;
+		std::vector<entry, btree_allocator<entry>> table_;
+		btree_bloom_detail::mixed_hash<T> hash_;
+		mutable std::atomic<std::uint64_t> lookups_, staleHints_;
+};
+
+#endif
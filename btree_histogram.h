@@ -0,0 +1,127 @@
+/**
+ * A compact latency histogram in the style of HdrHistogram.
+ *
+ * Values are bucketed log-linearly: every power of two is split into a
+ * fixed number of linear sub-buckets, so the relative error of any
+ * recorded value is bounded (below 1/64, about 1.6%, with the default 7
+ * bits) however large it is, while recording stays a shift, a
+ * count-leading-zeros and an increment.  Values below the sub-bucket
+ * count are recorded exactly.
+ */
+
+#ifndef BTREE_HISTOGRAM_H
+#define BTREE_HISTOGRAM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+class latency_histogram {
+	public:
+		/**
+		 * @param precision the number of significant bits kept per
+		 *        value; each power of two gets 2^(precision-1) buckets
+		 */
+		explicit latency_histogram(unsigned precision = 7)
+			: precision_{precision}, count_{0}, sum_{0},
+			  min_{std::numeric_limits<std::uint64_t>::max()}, max_{0} {
+			if(precision_ < 1 || precision_ > 16){
+				throw std::invalid_argument("latency_histogram precision must be in [1, 16]");
+			}
+			counts_.assign(index(std::numeric_limits<std::uint64_t>::max()) + 1, 0);
+		}
+
+		void record(std::uint64_t value) {
+			++counts_[index(value)];
+			++count_;
+			sum_ += value;
+			min_ = std::min(min_, value);
+			max_ = std::max(max_, value);
+		}
+
+		/**
+		 * Adds every value recorded in other, which must have been
+		 * created with the same precision.
+		 */
+		void merge(const latency_histogram &other) {
+			if(other.precision_ != precision_){
+				throw std::invalid_argument("cannot merge histograms of different precision");
+			}
+			for(std::size_t i = 0; i < counts_.size(); ++i){
+				counts_[i] += other.counts_[i];
+			}
+			count_ += other.count_;
+			sum_ += other.sum_;
+			min_ = std::min(min_, other.min_);
+			max_ = std::max(max_, other.max_);
+		}
+
+		void reset() {
+			std::fill(counts_.begin(), counts_.end(), 0);
+			count_ = sum_ = max_ = 0;
+			min_ = std::numeric_limits<std::uint64_t>::max();
+		}
+
+		std::uint64_t count() const { return count_; }
+		std::uint64_t min() const { return count_ ? min_ : 0; }
+		std::uint64_t max() const { return max_; }
+		double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0; }
+
+		/**
+		 * The smallest recorded value such that at least the given
+		 * percentage of all values are no greater than it, to within
+		 * the histogram's precision.
+		 *
+		 * @param percentile in [0, 100]
+		 */
+		std::uint64_t percentile(double percentile) const {
+			if(count_ == 0) return 0;
+			double wanted = std::ceil(std::max(0.0, std::min(percentile, 100.0)) / 100.0 * count_);
+			std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(wanted));
+			std::uint64_t seen = 0;
+			for(std::size_t i = 0; i < counts_.size(); ++i){
+				seen += counts_[i];
+				if(seen >= rank){
+					return std::min(highest(i), max_);
+				}
+			}
+			return max_;
+		}
+
+	private:
+		/**
+		 * Keeps the top `precision` bits of the value: the shift is the
+		 * number of low bits dropped and the mantissa what is left.
+		 */
+		std::size_t index(std::uint64_t value) const {
+			unsigned shift = 0;
+			if(value >> precision_){
+				unsigned msb = 63 - __builtin_clzll(value);
+				shift = msb - precision_ + 1;
+			}
+			std::uint64_t half = std::uint64_t{1} << (precision_ - 1);
+			return shift * half + (value >> shift);
+		}
+
+		/**
+		 * The largest value that falls in bucket i.
+		 */
+		std::uint64_t highest(std::size_t i) const {
+			std::uint64_t half = std::uint64_t{1} << (precision_ - 1);
+			std::uint64_t full = half * 2;
+			if(i < full) return i;
+			unsigned shift = static_cast<unsigned>((i - half) / half);
+			std::uint64_t mantissa = i - shift * half;
+			return ((mantissa + 1) << shift) - 1;
+		}
+
+		unsigned precision_;
+		std::vector<std::uint64_t> counts_;
+		std::uint64_t count_, sum_, min_, max_;
+};
+
+#endif
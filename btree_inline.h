@@ -0,0 +1,96 @@
+/**
+ * The elements of a small btree, held in the btree object itself.
+ *
+ * Until a tree outgrows it, its root is this: up to N elements in order
+ * in a fixed array, constructed in place as they arrive, so a tree that
+ * never holds more than N elements makes no allocation at all, much as a
+ * short std::string keeps its characters in the string object.  Once the
+ * tree needs more, the elements move to a real node and this is emptied.
+ */
+
+#ifndef BTREE_INLINE_H
+#define BTREE_INLINE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename T, size_t N>
+class btree_inline {
+	static_assert(N > 0, "btree_inline needs room for an element");
+
+	public:
+		btree_inline() : size_{0} { }
+		~btree_inline() { clear(); }
+
+		btree_inline(const btree_inline &other) : size_{0} { copy(other); }
+
+		/**
+		 * Moves other's elements here, leaving it empty.  Throws only if
+		 * moving an element can.
+		 */
+		btree_inline(btree_inline &&other) noexcept(std::is_nothrow_move_constructible<T>::value) : size_{0} { take(other); }
+
+		btree_inline& operator=(const btree_inline &other) {
+			if(this != &other){
+				clear();
+				copy(other);
+			}
+			return *this;
+		}
+
+		btree_inline& operator=(btree_inline &&other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+			if(this != &other){
+				clear();
+				take(other);
+			}
+			return *this;
+		}
+
+		static size_t capacity() { return N; }
+		size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+
+		T* data() { return reinterpret_cast<T*>(data_); }
+		const T* data() const { return reinterpret_cast<const T*>(data_); }
+
+		T& operator[](size_t slot) { return data()[slot]; }
+		const T& operator[](size_t slot) const { return data()[slot]; }
+
+		size_t lower_bound(const T& elem) const { return std::lower_bound(data(), data() + size_, elem) - data(); }
+
+		/**
+		 * Adds elem at slot before, which must be at most size(), moving
+		 * each element after it once.  There must be room.
+		 */
+		void insert(size_t before, const T& elem) {
+			new (data() + size_) T(elem);
+			++size_;
+			std::rotate(data() + before, data() + size_ - 1, data() + size_);
+		}
+
+		/**
+		 * Destroys every element.
+		 */
+		void clear() {
+			for(size_t slot = 0; slot < size_; ++slot) data()[slot].~T();
+			size_ = 0;
+		}
+
+	private:
+		size_t size_;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type data_[N];
+
+		void copy(const btree_inline &other) {
+			for(; size_ < other.size_; ++size_) new (data() + size_) T(other[size_]);
+		}
+
+		void take(btree_inline &other) {
+			for(; size_ < other.size_; ++size_) new (data() + size_) T(std::move(other[size_]));
+			other.clear();
+		}
+};
+
+#endif
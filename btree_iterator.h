@@ -1,10 +1,14 @@
 #ifndef BTREE_ITERATOR_H
 #define BTREE_ITERATOR_H
 
+#include <algorithm>
+#include <cstdint>
 #include <iterator>
 #include <utility>
 #include <cassert>
 
+#include "btree_counters.h"
+
 /**
  * You MUST implement the btree iterators as (an) external class(es) in this file.
  * Failure to do so will result in a total mark of 0 for this deliverable.
@@ -14,17 +18,126 @@
 // iterator class btree_iterator (and possibly const_btree_iterator)
 
 template<typename T> class btree;
+template<typename Node> class btree_arena;
+
+#ifdef BTREE_PATH_ITERATORS
+/**
+ * Building with BTREE_PATH_ITERATORS defined drops the parent handle and
+ * slot from every node, and iterators carry the way down to their node
+ * instead: the ancestors, and the child slot taken at each.  ++ and --
+ * push a step on the way down and pop one on the way up, so climbing
+ * reads nothing but the iterator itself.
+ *
+ * The steps live in the iterator, so they are capped: only the deepest
+ * kDepth are kept.  A tree whose sorted inserts made it a long chain can
+ * be deeper than that, and an iterator made from a bare node and slot,
+ * as find returns, knows no steps at all; in either case the way down is
+ * found again by searching from the root for the node's first element.
+ */
+template <typename Node>
+struct btree_path {
+	static const unsigned kDepth = 8;
+
+	Node *nodes[kDepth];
+	std::uint16_t slots[kDepth];
+	std::uint8_t top;       // where the next step goes, wrapping round
+	std::uint8_t kept;      // steps held, the deepest first
+	bool rooted;
+	size_t depth;           // steps from the root, if rooted
+
+	btree_path() : nodes{}, slots{}, top{0}, kept{0}, rooted{false}, depth{0} { }
+
+	void push(Node *at, size_t slot) {
+		nodes[top] = at;
+		slots[top] = static_cast<std::uint16_t>(slot);
+		top = (top + 1) % kDepth;
+		if(kept < kDepth) ++kept;
+		++depth;
+	}
+
+	std::pair<Node*, size_t> pop() {
+		top = (top + kDepth - 1) % kDepth;
+		--kept;
+		--depth;
+		return {nodes[top], slots[top]};
+	}
+};
+#endif
 
 template<typename T, typename RetVal>
 class btree_iterator {
 	private:
 		using node = typename btree<T>::node;
+		using arena = btree_arena<node>;
 
+		// nodes link to each other by handle, so moving between them
+		// goes through the tree's node store
+		const arena *arena_;
 		node *cur_;
 		size_t index_;
+		// the elements of a tree small enough to hold them inline, in
+		// order; null for an iterator into nodes
+		T *flat_;
+#ifdef BTREE_PATH_ITERATORS
+		btree_path<node> path_;
+#endif
+
+		btree_iterator(const arena *nodes, node *cur, size_t index) : arena_{nodes}, cur_{cur}, index_{index}, flat_{nullptr} { }
+		btree_iterator(const arena *nodes, std::pair<node*, size_t> pair) : btree_iterator{nodes, pair.first, pair.second} { }
+		btree_iterator(T *flat, size_t index) : arena_{nullptr}, cur_{nullptr}, index_{index}, flat_{flat} { }
 
-		btree_iterator(node *cur, size_t index) : cur_{cur}, index_{index} { }
-		btree_iterator(std::pair<node*, size_t> pair) : btree_iterator{pair.first, pair.second} { }
+		// moving to a child, and back to the parent
+		void down(size_t slot) {
+#ifdef BTREE_PATH_ITERATORS
+			path_.push(cur_, slot);
+#endif
+			cur_ = arena_->at(cur_->children_[slot]);
+		}
+
+		void up() {
+			BTREE_COUNT(parent_climbs);
+#ifdef BTREE_PATH_ITERATORS
+			if(path_.kept == 0) reroot();
+			auto step = path_.pop();
+			cur_ = step.first;
+			index_ = step.second;
+#else
+			index_ = cur_->index_;
+			cur_ = arena_->at(cur_->parent_);
+#endif
+		}
+
+		bool at_root() const {
+#ifdef BTREE_PATH_ITERATORS
+			return cur_ == arena_->at(1);
+#else
+			return !cur_->parent_;
+#endif
+		}
+
+#ifdef BTREE_PATH_ITERATORS
+		/**
+		 * Finds the way down to cur_ again, keeping its deepest steps.
+		 */
+		void reroot() {
+			const auto &target = cur_->values_.front();
+			path_ = btree_path<node>();
+			path_.rooted = true;
+			for(node *at = arena_->at(1); at != cur_; ){
+				size_t slot = at->values_.lower_bound(target);
+				path_.push(at, slot);
+				at = arena_->at(at->children_[slot]);
+			}
+		}
+
+		/**
+		 * Levels above the current node.
+		 */
+		size_t depth() {
+			if(!path_.rooted) reroot();
+			return path_.depth;
+		}
+#endif
 
 	public:
 		typedef std::ptrdiff_t difference_type;
@@ -38,16 +151,20 @@ class btree_iterator {
 		friend class btree<T>;
 
 		operator btree_iterator<T, typename std::add_const<RetVal>::type>() const {
-			return {cur_, index_};
+			btree_iterator<T, typename std::add_const<RetVal>::type> copy{arena_, cur_, index_};
+			copy.flat_ = flat_;
+#ifdef BTREE_PATH_ITERATORS
+			copy.path_ = path_;
+#endif
+			return copy;
 		}
 
-		reference operator*() const { return cur_->values_.at(index_); }
+		reference operator*() const { return flat_ ? flat_[index_] : cur_->values_.at(index_); }
 		pointer operator->() const { return &(operator*()); }
 
 		template <typename U>
 		bool operator==(const btree_iterator<T, U> &other) const {
-			if(!cur_ && !other.cur_) return true;
-			return (other.cur_ == cur_) && (other.index_ == index_);
+			return (other.cur_ == cur_) && (other.flat_ == flat_) && (other.index_ == index_);
 		}
 
 		template <typename U>
@@ -56,17 +173,17 @@ class btree_iterator {
 		}
 
 		btree_iterator& operator++(){
-			const auto &ptr = cur_->children_.at(index_ + 1);
-			if(ptr){
-				for(cur_ = ptr.get(); *cur_->children_.begin(); cur_ = cur_->children_.begin()->get());
-				index_ = 0;
+			if(flat_){
+				++index_;
+			}
+			else if(cur_->children_.at(index_ + 1)){
+				for(down(index_ + 1); cur_->children_.front(); down(0));
+				index_ = cur_->values_.first();
 			}
 			else{
-				++index_;
-				while(index_ == cur_->values_.size() && cur_->parent_){
-					index_ = cur_->index_;
-					cur_ = cur_->parent_;
-				}
+				// a leaf still filling skips its gaps
+				index_ = cur_->values_.next(index_);
+				while(index_ == cur_->values_.slots() && !at_root()) up();
 			}
 			return *this;
 		}
@@ -78,17 +195,16 @@ class btree_iterator {
 		}
 
 		btree_iterator& operator--(){
-			const auto &ptr = cur_->children_.at(index_);
-			if(ptr){
-				for(cur_ = ptr.get(); *cur_->children_.rbegin(); cur_ = cur_->children_.rbegin()->get());
-				index_ = cur_->values_.size() - 1;
+			if(flat_){
+				--index_;
+			}
+			else if(cur_->children_.at(index_)){
+				for(down(index_); cur_->children_.back(); down(cur_->children_.size() - 1));
+				index_ = cur_->values_.prev(cur_->values_.slots());
 			}
 			else{
-				while(index_ == 0){
-					index_ = cur_->index_;
-					cur_ = cur_->parent_;
-				}
-				index_--;
+				while(index_ == cur_->values_.first()) up();
+				index_ = cur_->values_.prev(index_);
 			}
 			return *this;
 		}
@@ -0,0 +1,33 @@
+/**
+ * Integer keys as 64-bit patterns that sort the same way as the keys.
+ *
+ * Read-only key sets pack and compare keys as unsigned bits: a signed
+ * key has its sign bit flipped, so negative keys come before the rest,
+ * and an unsigned key is widened as it is.
+ */
+
+#ifndef BTREE_KEY_BITS_H
+#define BTREE_KEY_BITS_H
+
+#include <cstdint>
+#include <type_traits>
+
+template <typename K>
+struct key_bits {
+	static_assert(std::is_integral<K>::value, "key bits need integral keys");
+
+	static std::uint64_t encode(K key) {
+		return static_cast<std::uint64_t>(key) ^ flip();
+	}
+
+	static K decode(std::uint64_t bits) {
+		return static_cast<K>(bits ^ flip());
+	}
+
+	private:
+		static constexpr std::uint64_t flip() {
+			return std::is_signed<K>::value ? std::uint64_t{1} << 63 : 0;
+		}
+};
+
+#endif
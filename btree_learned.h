@@ -0,0 +1,189 @@
+/**
+ * A learned index over a frozen set of integer keys.
+ *
+ * The keys are kept in one sorted array, and a piecewise linear model
+ * maps each key to its position there.  The model is built in one pass
+ * with the shrinking-cone method: a segment starts at a key and keeps
+ * taking keys while some slope predicts every one of them to within
+ * epsilon positions; when none does, the next segment starts.  A lookup
+ * binary searches the segments' first keys, which are few enough to stay
+ * in cache, predicts a position from its segment and then binary
+ * searches only the 2 * epsilon + 3 keys around the prediction.  Both
+ * searches are branch-free.
+ *
+ * Sequential keys need a single segment and uniform keys very few, so
+ * the model is a small fraction of the size of the keys, let alone of a
+ * node-based tree over them.
+ *
+ * Build one from a btree, or a frozen_btree, of an integral type:
+ *
+ *     learned_index<long> index(tree.begin(), tree.end());
+ */
+
+#ifndef BTREE_LEARNED_H
+#define BTREE_LEARNED_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "btree_alloc.h"
+
+template <typename K>
+class learned_index {
+	static_assert(std::is_integral<K>::value, "a learned index needs integral keys");
+
+	public:
+		using const_iterator = typename std::vector<K, btree_allocator<K>>::const_iterator;
+		using iterator = const_iterator;
+		using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+		using reverse_iterator = const_reverse_iterator;
+
+		learned_index() : epsilon_{0} { }
+
+		/**
+		 * Builds the index over a sorted range.
+		 *
+		 * @param first, last distinct keys in ascending order
+		 * @param epsilon the most positions a prediction may be off by;
+		 *        smaller means more segments and shorter final searches
+		 */
+		template <typename InputIt>
+		learned_index(InputIt first, InputIt last, size_t epsilon = 32);
+
+		size_t size() const { return keys_.size(); }
+		bool empty() const { return keys_.empty(); }
+		size_t epsilon() const { return epsilon_; }
+		size_t segments() const { return segments_.size(); }
+
+		/**
+		 * Heap bytes held by the model, and by the model and the keys.
+		 */
+		size_t model_bytes() const { return segments_.capacity() * sizeof(segment) + firsts_.capacity() * sizeof(K); }
+		size_t bytes() const { return model_bytes() + keys_.capacity() * sizeof(K); }
+
+		const_iterator begin() const { return keys_.begin(); }
+		const_iterator end() const { return keys_.end(); }
+		const_iterator cbegin() const { return begin(); }
+		const_iterator cend() const { return end(); }
+		const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+		const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+		/**
+		 * The first key not less than key, or end().
+		 */
+		const_iterator lower_bound(K key) const;
+
+		/**
+		 * The matching key, or end() if there is none.
+		 */
+		const_iterator find(K key) const {
+			auto it = lower_bound(key);
+			return it != end() && *it == key ? it : end();
+		}
+
+		bool contains(K key) const { return find(key) != end(); }
+
+	private:
+		struct segment {
+			K first;          // the segment's smallest key
+			double slope;     // positions per unit of key
+			size_t start;     // the position of first
+		};
+
+		/**
+		 * How many of the len keys from first are less than key (or, with
+		 * inclusive, not greater than it).  The loop has no data-dependent
+		 * branch, so the compiler turns each step into a conditional move
+		 * and random lookups do not pay for mispredictions.
+		 */
+		template <bool inclusive>
+		static size_t rank(const K *first, size_t len, K key) {
+			if(len == 0) return 0;
+			const K *base = first;
+			while(len > 1){
+				size_t half = len / 2;
+				base += (inclusive ? !(key < base[half]) : base[half] < key) ? half : 0;
+				len -= half;
+			}
+			return base - first + (inclusive ? !(key < *base) : *base < key);
+		}
+
+		static double distance(K from, K to) {
+			// as unsigned, so the difference cannot overflow
+			return static_cast<double>(static_cast<std::uint64_t>(to) - static_cast<std::uint64_t>(from));
+		}
+
+		size_t epsilon_;
+		std::vector<K, btree_allocator<K>> keys_;
+		std::vector<segment, btree_allocator<segment>> segments_;
+		std::vector<K, btree_allocator<K>> firsts_;    // segments_[i].first, packed for searching
+};
+
+template <typename K>
+template <typename InputIt>
+learned_index<K>::learned_index(InputIt first, InputIt last, size_t epsilon)
+	: epsilon_{epsilon}, keys_(first, last) {
+
+	const double eps = static_cast<double>(epsilon);
+	size_t start = 0;
+	double low = 0, high = std::numeric_limits<double>::infinity();
+
+	auto close = [&](size_t end) {
+		double slope = end - start > 1 ? (low + high) / 2 : 0;
+		segments_.push_back({keys_[start], slope, start});
+		firsts_.push_back(keys_[start]);
+	};
+
+	for(size_t i = 1; i < keys_.size(); ++i){
+		// the slopes that put key i within epsilon of position i
+		double dx = distance(keys_[start], keys_[i]), dy = static_cast<double>(i - start);
+		double lo = (dy - eps) / dx, hi = (dy + eps) / dx;
+		if(lo > high || hi < low){
+			close(i);
+			start = i;
+			low = 0;
+			high = std::numeric_limits<double>::infinity();
+		}
+		else{
+			low = std::max(low, lo);
+			high = std::min(high, hi);
+		}
+	}
+	if(!keys_.empty()) close(keys_.size());
+	segments_.shrink_to_fit();
+	firsts_.shrink_to_fit();
+}
+
+template <typename K>
+auto learned_index<K>::lower_bound(K key) const
+	-> const_iterator {
+
+	if(keys_.empty() || key <= keys_.front()) return keys_.begin();
+
+	size_t s = rank<true>(firsts_.data(), firsts_.size(), key) - 1;
+	const segment &seg = segments_[s];
+	size_t limit = s + 1 < segments_.size() ? segments_[s + 1].start : keys_.size();
+
+	// the prediction, clamped to the segment; one extra position either
+	// side absorbs floating point rounding
+	double predicted = seg.start + seg.slope * distance(seg.first, key);
+	size_t pos = predicted >= limit ? limit : static_cast<size_t>(predicted);
+	size_t from = pos > seg.start + epsilon_ + 1 ? pos - epsilon_ - 1 : seg.start;
+	size_t to = std::min(limit, pos + epsilon_ + 2);
+
+	auto begin = keys_.begin();
+	auto it = begin + from + rank<false>(keys_.data() + from, to - from, key);
+	if((it == begin + from && from > 0 && !(begin[from - 1] < key))
+			|| (it == begin + to && to < keys_.size() && begin[to] < key)){
+		// the model was wrong, which the construction rules out
+		return std::lower_bound(begin, keys_.end(), key);
+	}
+	return it;
+}
+
+#endif
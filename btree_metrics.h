@@ -0,0 +1,225 @@
+/**
+ * A metrics registry for embedded B-Trees.
+ *
+ * Trees register with a registry under a name (see
+ * btree<T>::register_metrics).  From then on each tree counts its
+ * inserts, finds, find hits and misses, splits (a full node spilling an
+ * element into a new child) and node allocations.  At render time the
+ * registry also reads each tree's size, height, node count and bytes.
+ * render() writes everything in the Prometheus text exposition format.
+ *
+ * Counting is the hot path, so each entry keeps its counters in
+ * cache-line aligned shards, and a thread always increments the same
+ * shard.  Threads only share a shard once there are more of them than
+ * shards.  Gauges are computed when rendering, by walking the tree.
+ * Rendering must not run concurrently with inserts into a registered
+ * tree, the same as any other read of the tree.
+ */
+
+#ifndef BTREE_METRICS_H
+#define BTREE_METRICS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace btree_metrics {
+
+enum counter { inserts, finds, hits, misses, splits, nodes_allocated, counters };
+
+/**
+ * The point-in-time readings of one tree.
+ */
+struct gauges {
+	size_t size;
+	size_t height;
+	size_t nodes;
+	size_t bytes;
+};
+
+class registry;
+
+namespace detail {
+
+const size_t kShards = 16;
+
+/**
+ * The shard the calling thread increments; threads are handed shards in
+ * turn as they first count something.
+ */
+inline size_t shard_index() {
+	static std::atomic<size_t> next{0};
+	thread_local size_t mine = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+	return mine;
+}
+
+struct alignas(64) shard {
+	std::atomic<std::uint64_t> values[counters];
+};
+
+}
+
+/**
+ * The metrics of one registered tree.  Owned by the registry.
+ */
+class entry {
+	public:
+		inline void add(counter c, std::uint64_t n = 1) {
+			shards_[detail::shard_index()].values[c].fetch_add(n, std::memory_order_relaxed);
+		}
+
+		std::uint64_t value(counter c) const {
+			std::uint64_t total = 0;
+			for(const auto &s : shards_){
+				total += s.values[c].load(std::memory_order_relaxed);
+			}
+			return total;
+		}
+
+		const std::string& name() const { return name_; }
+		registry& owner() const { return *owner_; }
+
+		// the global new of C++14 only aligns to max_align_t, so entries
+		// ask for their shards' cache line alignment themselves
+		static void* operator new(size_t bytes) {
+			void *ptr;
+			if(posix_memalign(&ptr, alignof(entry), bytes)) throw std::bad_alloc();
+			return ptr;
+		}
+		static void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+	private:
+		friend class registry;
+
+		entry(registry *owner, const std::string &name, const void *source, gauges (*read)(const void*))
+			: owner_{owner}, name_(name), source_{source}, read_{read} {
+			for(auto &s : shards_){
+				for(auto &v : s.values){
+					v.store(0, std::memory_order_relaxed);
+				}
+			}
+		}
+
+		registry *owner_;
+		std::string name_;
+		const void *source_;
+		gauges (*read_)(const void*);
+		detail::shard shards_[detail::kShards];
+};
+
+class registry {
+	public:
+		registry() = default;
+		registry(const registry&) = delete;
+		registry& operator=(const registry&) = delete;
+
+		/**
+		 * Registers a source of metrics.  Trees call this through
+		 * btree<T>::register_metrics rather than directly.
+		 *
+		 * @param name the value of the tree label; must be unique
+		 * @param source passed back to read when rendering
+		 * @param read computes the gauges of source
+		 * @return the entry to count into, valid until removed
+		 * @throw std::invalid_argument if the name is already taken
+		 */
+		entry* add(const std::string &name, const void *source, gauges (*read)(const void*)) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			for(const auto &e : entries_){
+				if(e->name_ == name){
+					throw std::invalid_argument("btree metrics name already registered: " + name);
+				}
+			}
+			entries_.emplace_back(new entry(this, name, source, read));
+			return entries_.back().get();
+		}
+
+		/**
+		 * Unregisters an entry, which must not be used afterwards.
+		 */
+		void remove(entry *e) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+					[e](const std::unique_ptr<entry> &p) { return p.get() == e; }), entries_.end());
+		}
+
+		size_t size() const {
+			std::lock_guard<std::mutex> lock(mutex_);
+			return entries_.size();
+		}
+
+		/**
+		 * Writes every metric of every registered tree in the Prometheus
+		 * text exposition format, one family at a time.
+		 */
+		void render(std::ostream &os) const {
+			std::lock_guard<std::mutex> lock(mutex_);
+			std::vector<gauges> readings;
+			for(const auto &e : entries_){
+				readings.push_back(e->read_(e->source_));
+			}
+
+			struct family { const char *name, *help; counter c; };
+			static const family counts[] = {
+				{"btree_inserts_total", "Calls to insert.", inserts},
+				{"btree_finds_total", "Calls to find.", finds},
+				{"btree_find_hits_total", "Finds that matched an element.", hits},
+				{"btree_find_misses_total", "Finds that matched nothing.", misses},
+				{"btree_splits_total", "Full nodes that spilled an element into a new child node.", splits},
+				{"btree_nodes_allocated_total", "Nodes allocated by inserts and copies.", nodes_allocated},
+			};
+			for(const auto &f : counts){
+				header(os, f.name, f.help, "counter");
+				for(const auto &e : entries_){
+					sample(os, f.name, e->name_, e->value(f.c));
+				}
+			}
+
+			struct gauge { const char *name, *help; size_t gauges::*field; };
+			static const gauge levels[] = {
+				{"btree_size", "Elements stored.", &gauges::size},
+				{"btree_height", "Levels in the tree.", &gauges::height},
+				{"btree_nodes", "Nodes in the tree.", &gauges::nodes},
+				{"btree_bytes", "Heap bytes held by the tree: nodes, reserved spares, Bloom filter and hash index.", &gauges::bytes},
+			};
+			for(const auto &g : levels){
+				header(os, g.name, g.help, "gauge");
+				for(size_t i = 0; i < entries_.size(); ++i){
+					sample(os, g.name, entries_[i]->name_, readings[i].*g.field);
+				}
+			}
+		}
+
+	private:
+		static void header(std::ostream &os, const char *name, const char *help, const char *type) {
+			os << "# HELP " << name << ' ' << help << '\n'
+				<< "# TYPE " << name << ' ' << type << '\n';
+		}
+
+		static void sample(std::ostream &os, const char *name, const std::string &tree, std::uint64_t value) {
+			os << name << "{tree=\"";
+			for(char c : tree){
+				if(c == '\\') os << "\\\\";
+				else if(c == '"') os << "\\\"";
+				else if(c == '\n') os << "\\n";
+				else os << c;
+			}
+			os << "\"} " << value << '\n';
+		}
+
+		mutable std::mutex mutex_;
+		std::vector<std::unique_ptr<entry>> entries_;
+};
+
+}
+
+#endif
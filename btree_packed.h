@@ -0,0 +1,267 @@
+/**
+ * A read-only set of integer keys packed with frame-of-reference
+ * encoding, for frozen trees whose keys sit close to their neighbours,
+ * such as timestamps and sequential IDs.
+ *
+ * The sorted keys are cut into blocks of 64, the size of a node.  Each
+ * block keeps its smallest key as a base and stores every key as its
+ * distance from that base, in the narrowest of 8, 16, 32 or 64 bits that
+ * holds the block's spread.  Keys a millisecond or a few IDs apart fit
+ * in a byte each, an eighth of a long, so eight times as many share a
+ * cache line.
+ *
+ * A lookup binary searches the block bases and then counts the deltas
+ * below the key's delta across the whole block.  Blocks are padded to 64
+ * deltas with the widest value, which is never below a key's delta, so
+ * the count is a fixed-length loop with no branch that the compiler
+ * turns into SIMD compares over 16 narrow deltas at a time.
+ *
+ * One key more can widen every delta of its block and shift the blocks
+ * after it, so the set is built once, from the sorted contents of a
+ * tree, and never changed:
+ *
+ *     packed_set<long> keys(tree.begin(), tree.end());
+ */
+
+#ifndef BTREE_PACKED_H
+#define BTREE_PACKED_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "btree_alloc.h"
+#include "btree_key_bits.h"
+
+template <typename K>
+class packed_set {
+	static_assert(std::is_integral<K>::value, "a packed set needs integral keys");
+
+	public:
+		class const_iterator {
+			public:
+				typedef std::ptrdiff_t difference_type;
+				typedef std::bidirectional_iterator_tag iterator_category;
+				typedef K value_type;
+				typedef const K* pointer;
+				typedef K reference;
+
+				const_iterator() : set_{nullptr}, block_{0}, at_{0} { }
+
+				K operator*() const { return set_->key(block_, at_); }
+
+				bool operator==(const const_iterator &other) const {
+					return block_ == other.block_ && at_ == other.at_;
+				}
+				bool operator!=(const const_iterator &other) const { return !(*this == other); }
+
+				const_iterator& operator++() {
+					if(++at_ == set_->blocks_[block_].count){
+						++block_;
+						at_ = 0;
+					}
+					return *this;
+				}
+
+				const_iterator operator++(int) {
+					auto copy = *this;
+					operator++();
+					return copy;
+				}
+
+				const_iterator& operator--() {
+					if(at_ == 0){
+						--block_;
+						at_ = set_->blocks_[block_].count;
+					}
+					--at_;
+					return *this;
+				}
+
+				const_iterator operator--(int) {
+					auto copy = *this;
+					operator--();
+					return copy;
+				}
+
+			private:
+				friend class packed_set;
+
+				const_iterator(const packed_set *set, size_t block, size_t at)
+					: set_{set}, block_{block}, at_{at} { }
+
+				const packed_set *set_;
+				size_t block_;      // blocks_.size() past the end
+				size_t at_;         // the key's position within its block
+		};
+
+		using iterator = const_iterator;
+		using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+		using reverse_iterator = const_reverse_iterator;
+
+		packed_set() : size_{0} { }
+
+		/**
+		 * Encodes a sorted range.
+		 *
+		 * @param first, last distinct keys in ascending order
+		 */
+		template <typename InputIt>
+		packed_set(InputIt first, InputIt last);
+
+		size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+
+		/**
+		 * Heap bytes held by the set, and how many blocks store their
+		 * deltas in the given number of bytes (1, 2, 4 or 8).
+		 */
+		size_t bytes() const {
+			return blocks_.capacity() * sizeof(block) + bases_.capacity() * sizeof(std::uint64_t)
+				+ d8_.capacity() + d16_.capacity() * 2 + d32_.capacity() * 4 + d64_.capacity() * 8;
+		}
+		size_t blocks(size_t width) const {
+			return std::count_if(blocks_.begin(), blocks_.end(), [width](const block &b) { return b.width == width; });
+		}
+
+		const_iterator begin() const { return const_iterator(this, 0, 0); }
+		const_iterator end() const { return const_iterator(this, blocks_.size(), 0); }
+		const_iterator cbegin() const { return begin(); }
+		const_iterator cend() const { return end(); }
+		const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+		const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+		/**
+		 * The first key not less than key, or end().
+		 */
+		const_iterator lower_bound(K key) const;
+
+		const_iterator find(K key) const {
+			auto it = lower_bound(key);
+			return it != end() && *it == key ? it : end();
+		}
+
+		bool contains(K key) const { return find(key) != end(); }
+
+	private:
+		static const size_t kBlockKeys = 64;
+
+		struct block {
+			std::uint8_t width;     // bytes a delta
+			std::uint8_t count;     // keys, up to kBlockKeys
+			size_t offset;          // the first delta in the vector for width
+		};
+
+		/**
+		 * How many of a block's deltas are below delta.  The trip count is
+		 * fixed and the body has no branch, so this vectorises.
+		 */
+		template <typename D>
+		static size_t below(const D *deltas, std::uint64_t delta) {
+			if(delta > std::numeric_limits<D>::max()) return kBlockKeys;
+			D target = static_cast<D>(delta), n = 0;
+			for(size_t i = 0; i < kBlockKeys; ++i) n += deltas[i] < target;
+			return n;
+		}
+
+		template <typename D>
+		static void pack(std::vector<D, btree_allocator<D>> &to, const std::vector<std::uint64_t> &from, size_t first, size_t count) {
+			std::uint64_t base = from[first];
+			for(size_t i = 0; i < count; ++i) to.push_back(static_cast<D>(from[first + i] - base));
+			to.resize(to.size() + kBlockKeys - count, std::numeric_limits<D>::max());
+		}
+
+		K key(size_t b, size_t at) const {
+			const block &bl = blocks_[b];
+			size_t i = bl.offset + at;
+			std::uint64_t delta = bl.width == 1 ? d8_[i] : bl.width == 2 ? d16_[i] : bl.width == 4 ? d32_[i] : d64_[i];
+			return key_bits<K>::decode(bases_[b] + delta);
+		}
+
+		size_t size_;
+		std::vector<block, btree_allocator<block>> blocks_;
+		std::vector<std::uint64_t, btree_allocator<std::uint64_t>> bases_;   // each block's encoded first key
+		std::vector<std::uint8_t, btree_allocator<std::uint8_t>> d8_;
+		std::vector<std::uint16_t, btree_allocator<std::uint16_t>> d16_;
+		std::vector<std::uint32_t, btree_allocator<std::uint32_t>> d32_;
+		std::vector<std::uint64_t, btree_allocator<std::uint64_t>> d64_;
+};
+
+template <typename K>
+template <typename InputIt>
+packed_set<K>::packed_set(InputIt first, InputIt last) : size_{0} {
+	std::vector<std::uint64_t> bits;
+	for(auto it = first; it != last; ++it) bits.push_back(key_bits<K>::encode(*it));
+	size_ = bits.size();
+
+	for(size_t start = 0; start < bits.size(); start += kBlockKeys){
+		size_t count = bits.size() - start < kBlockKeys ? bits.size() - start : kBlockKeys;
+		std::uint64_t spread = bits[start + count - 1] - bits[start];
+
+		// the narrowest width that holds the spread; a key whose delta
+		// equals the padding is still told apart, as neither is below it
+		block b{8, static_cast<std::uint8_t>(count), 0};
+		if(spread <= std::numeric_limits<std::uint8_t>::max()){
+			b.width = 1;
+			b.offset = d8_.size();
+			pack(d8_, bits, start, count);
+		}
+		else if(spread <= std::numeric_limits<std::uint16_t>::max()){
+			b.width = 2;
+			b.offset = d16_.size();
+			pack(d16_, bits, start, count);
+		}
+		else if(spread <= std::numeric_limits<std::uint32_t>::max()){
+			b.width = 4;
+			b.offset = d32_.size();
+			pack(d32_, bits, start, count);
+		}
+		else{
+			b.offset = d64_.size();
+			pack(d64_, bits, start, count);
+		}
+		blocks_.push_back(b);
+		bases_.push_back(bits[start]);
+	}
+	blocks_.shrink_to_fit();
+	bases_.shrink_to_fit();
+	d8_.shrink_to_fit();
+	d16_.shrink_to_fit();
+	d32_.shrink_to_fit();
+	d64_.shrink_to_fit();
+}
+
+template <typename K>
+auto packed_set<K>::lower_bound(K key) const
+	-> const_iterator {
+
+	std::uint64_t bits = key_bits<K>::encode(key);
+	if(blocks_.empty() || bits <= bases_.front()) return begin();
+
+	// the last block whose base is not above the key, branch-free
+	const std::uint64_t *base = bases_.data();
+	size_t len = bases_.size();
+	while(len > 1){
+		size_t half = len / 2;
+		base += base[half] <= bits ? half : 0;
+		len -= half;
+	}
+	size_t b = base - bases_.data();
+
+	const block &bl = blocks_[b];
+	std::uint64_t delta = bits - *base;
+	size_t at = bl.width == 1 ? below(d8_.data() + bl.offset, delta)
+		: bl.width == 2 ? below(d16_.data() + bl.offset, delta)
+		: bl.width == 4 ? below(d32_.data() + bl.offset, delta)
+		: below(d64_.data() + bl.offset, delta);
+
+	// past the block's last key, the answer is the next block's first
+	if(at >= bl.count) return const_iterator(this, b + 1, 0);
+	return const_iterator(this, b, at);
+}
+
+#endif
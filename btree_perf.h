@@ -0,0 +1,165 @@
+/**
+ * Hardware performance counters for the benchmark harness.
+ *
+ * perf_counters opens one Linux perf_event_open counter per event for the
+ * calling thread (user space only) and reads them around a region of
+ * code.  Each event is opened on its own rather than as a group, so an
+ * event the machine or container does not support only disables that
+ * column; if perf_event_open is unavailable altogether (other platforms,
+ * seccomp, perf_event_paranoid) every event reports as unavailable and
+ * the reason is kept for display.  Counts are scaled by enabled/running
+ * time in case the kernel multiplexes the counters.
+ */
+
+#ifndef BTREE_PERF_H
+#define BTREE_PERF_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class perf_counters {
+	public:
+		enum event { instructions, cache_misses, branch_misses, dtlb_misses, events };
+
+		perf_counters() {
+			for(std::size_t i = 0; i < events; ++i){
+				fds_[i] = -1;
+				values_[i] = 0;
+			}
+#ifdef __linux__
+			for(std::size_t i = 0; i < events; ++i){
+				perf_event_attr attr;
+				std::memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.disabled = 1;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+				configure(static_cast<event>(i), attr);
+
+				fds_[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+				if(fds_[i] < 0 && reason_.empty()){
+					reason_ = std::string("perf_event_open: ") + std::strerror(errno);
+				}
+			}
+#else
+			reason_ = "hardware counters are only supported on Linux";
+#endif
+		}
+
+		~perf_counters() {
+#ifdef __linux__
+			for(auto fd : fds_){
+				if(fd >= 0) close(fd);
+			}
+#endif
+		}
+
+		perf_counters(const perf_counters&) = delete;
+		perf_counters& operator=(const perf_counters&) = delete;
+
+		/**
+		 * Whether the given event, or any event at all, can be counted.
+		 */
+		bool available(event e) const { return fds_[e] >= 0; }
+
+		bool available() const {
+			for(auto fd : fds_){
+				if(fd >= 0) return true;
+			}
+			return false;
+		}
+
+		/**
+		 * Why some or all of the events are unavailable; empty if every
+		 * event opened.
+		 */
+		const std::string& reason() const { return reason_; }
+
+		/**
+		 * Zeroes and starts every available counter.
+		 */
+		void start() {
+#ifdef __linux__
+			for(auto fd : fds_){
+				if(fd < 0) continue;
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+
+		/**
+		 * Stops every available counter and latches its value.
+		 */
+		void stop() {
+#ifdef __linux__
+			for(std::size_t i = 0; i < events; ++i){
+				if(fds_[i] < 0) continue;
+				ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+				std::uint64_t data[3] = {0, 0, 0};
+				if(read(fds_[i], data, sizeof(data)) != sizeof(data)){
+					values_[i] = 0;
+				}
+				else if(data[2] == 0){
+					values_[i] = 0;
+				}
+				else{
+					values_[i] = static_cast<std::uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+				}
+			}
+#endif
+		}
+
+		/**
+		 * The count of the given event between the last start and stop.
+		 */
+		std::uint64_t value(event e) const { return values_[e]; }
+
+		static const char* name(event e) {
+			static const char* const names[] = {"instructions", "cache-misses", "branch-misses", "dTLB-misses"};
+			return names[e];
+		}
+
+	private:
+#ifdef __linux__
+		static void configure(event e, perf_event_attr &attr) {
+			switch(e){
+				case instructions:
+					attr.type = PERF_TYPE_HARDWARE;
+					attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+					break;
+				case cache_misses:
+					attr.type = PERF_TYPE_HARDWARE;
+					attr.config = PERF_COUNT_HW_CACHE_MISSES;
+					break;
+				case branch_misses:
+					attr.type = PERF_TYPE_HARDWARE;
+					attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+					break;
+				default:
+					attr.type = PERF_TYPE_HW_CACHE;
+					attr.config = PERF_COUNT_HW_CACHE_DTLB
+						| (PERF_COUNT_HW_CACHE_OP_READ << 8)
+						| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+					break;
+			}
+		}
+#endif
+
+		int fds_[events];
+		std::uint64_t values_[events];
+		std::string reason_;
+};
+
+#endif
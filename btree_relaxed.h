@@ -0,0 +1,25 @@
+/**
+ * Statistics counters bumped without a read-modify-write.
+ *
+ * A relaxed load and store costs next to nothing on the hot path.  A
+ * counter with one writer, such as a per-thread hot-path counter, loses
+ * nothing.  A counter several threads bump, such as a Bloom filter's
+ * checks, may lose the odd increment to a race, which statistics can
+ * bear better than the cost of an atomic add.
+ */
+
+#ifndef BTREE_RELAXED_H
+#define BTREE_RELAXED_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace btree_relaxed {
+
+inline void bump(std::atomic<std::uint64_t> &counter, std::uint64_t n = 1) {
+	counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+}
+
+#endif
@@ -0,0 +1,255 @@
+/**
+ * Replays a recorded operation trace (see btree_trace.h) against a chosen
+ * container configuration and reports throughput and per-operation
+ * latency percentiles.
+ *
+ * The trace is loaded into memory before the clock starts, and replay
+ * begins from an empty container.  Scans are replayed as full traversals
+ * since the trace records where a traversal starts but not how far it
+ * goes.  When built with BTREE_ALLOC_STATS (as the Makefile does), the
+ * allocations the btree engine made are reported too.
+ *
+ * Usage: btree_replay trace [engine] [node-size]
+ *   engine is one of btree (default), set or unordered_set; btree may
+ *   be followed by options, as in btree+bloom:
+ *     +bloom    a Bloom filter in front of find
+ *     +index    a hash side-index for point lookups
+ *     +flat=N   a flat sorted array until the tree holds more than N
+ *
+ * The btree engine is built from a config, so each optional feature of
+ * the tree can be named on the command line and a trace replayed with
+ * and without it.
+ **/
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "btree.h"
+#include "btree_histogram.h"
+#include "btree_trace.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// keeps the optimiser from discarding lookups and traversals
+volatile std::size_t sink;
+
+std::size_t weight(long v) { return static_cast<std::size_t>(v); }
+std::size_t weight(const string &v) { return v.size(); }
+
+/**
+ * How to build the btree engine; the other engines ignore it.
+ **/
+struct config {
+  size_t nodeSize = 40;
+  bool bloom = false;
+  bool hashIndex = false;
+  size_t flatElems = 0;
+};
+
+/**
+ * Splits an engine name such as btree+bloom into the engine and the
+ * btree options it turns on.
+ **/
+string parse(const string &name, config &conf) {
+  std::size_t plus = name.find('+');
+  string base = name.substr(0, plus);
+  while (plus != string::npos) {
+    std::size_t next = name.find('+', plus + 1);
+    string option = name.substr(plus + 1, next == string::npos ? string::npos : next - plus - 1);
+    if (base != "btree") throw std::invalid_argument("only btree takes options: " + name);
+    if (option == "bloom") conf.bloom = true;
+    else if (option == "index") conf.hashIndex = true;
+    else if (option.compare(0, 5, "flat=") == 0) conf.flatElems = std::strtoul(option.c_str() + 5, nullptr, 10);
+    else throw std::invalid_argument("unknown btree option: " + option);
+    plus = next;
+  }
+  return base;
+}
+
+/**
+ * Uniform interface over the engines a trace can be replayed against.
+ * Reverse scans are a no-op on unordered engines.
+ **/
+template <typename C> struct engine;
+
+template <typename T>
+struct engine<btree<T>> {
+  static btree<T>* make(const config &conf) {
+    btree<T> *tree = new btree<T>(conf.nodeSize, conf.flatElems);
+    if (conf.bloom) tree->enable_bloom();
+    if (conf.hashIndex) tree->enable_hash_index();
+    return tree;
+  }
+  static void insert(btree<T> &c, const T &k) { c.insert(k); }
+  static bool find(const btree<T> &c, const T &k) { return c.find(k) != c.end(); }
+  static std::size_t scan(const btree<T> &c) {
+    std::size_t acc = 0;
+    for (const auto &v : c) acc += weight(v);
+    return acc;
+  }
+  static std::size_t reverseScan(const btree<T> &c) {
+    std::size_t acc = 0;
+    for (auto it = c.rbegin(); it != c.rend(); ++it) acc += weight(*it);
+    return acc;
+  }
+};
+
+template <typename T>
+struct engine<std::set<T>> {
+  static std::set<T>* make(const config &) { return new std::set<T>(); }
+  static void insert(std::set<T> &c, const T &k) { c.insert(k); }
+  static bool find(const std::set<T> &c, const T &k) { return c.find(k) != c.end(); }
+  static std::size_t scan(const std::set<T> &c) {
+    std::size_t acc = 0;
+    for (const auto &v : c) acc += weight(v);
+    return acc;
+  }
+  static std::size_t reverseScan(const std::set<T> &c) {
+    std::size_t acc = 0;
+    for (auto it = c.rbegin(); it != c.rend(); ++it) acc += weight(*it);
+    return acc;
+  }
+};
+
+template <typename T>
+struct engine<std::unordered_set<T>> {
+  static std::unordered_set<T>* make(const config &) { return new std::unordered_set<T>(); }
+  static void insert(std::unordered_set<T> &c, const T &k) { c.insert(k); }
+  static bool find(const std::unordered_set<T> &c, const T &k) { return c.find(k) != c.end(); }
+  static std::size_t scan(const std::unordered_set<T> &c) {
+    std::size_t acc = 0;
+    for (const auto &v : c) acc += weight(v);
+    return acc;
+  }
+  static std::size_t reverseScan(const std::unordered_set<T> &) { return 0; }
+};
+
+const char* const kOpNames[] = {"insert", "find", "scan", "reverse_scan"};
+const std::size_t kOpKinds = 4;
+
+/**
+ * Prints the percentile row for the latencies of one kind of operation.
+ **/
+void report(const string &name, const latency_histogram &h) {
+  if (h.count() == 0) return;
+  cout << std::left << std::setw(14) << name << std::right
+       << std::setw(10) << h.count() << std::setw(10) << h.percentile(50)
+       << std::setw(10) << h.percentile(90) << std::setw(10) << h.percentile(99)
+       << std::setw(10) << h.percentile(99.9) << std::setw(12) << h.max()
+       << endl;
+}
+
+template <typename C, typename T>
+void replay(const vector<btree_trace::record<T>> &trace, const config &conf) {
+  using E = engine<C>;
+  latency_histogram latency[kOpKinds];
+  std::unique_ptr<C> c(E::make(conf));
+  std::size_t acc = 0;
+
+  btree_alloc::reset();
+  btree_alloc_stats before = btree_alloc::snapshot();
+  auto begin = clock_type::now();
+  for (const auto &rec : trace) {
+    auto start = clock_type::now();
+    switch (rec.op) {
+      case btree_trace::op::insert: E::insert(*c, rec.key); break;
+      case btree_trace::op::find: acc += E::find(*c, rec.key); break;
+      case btree_trace::op::scan: acc += E::scan(*c); break;
+      case btree_trace::op::reverse_scan: acc += E::reverseScan(*c); break;
+    }
+    auto stop = clock_type::now();
+    latency[static_cast<std::size_t>(rec.op)].record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+  }
+  double seconds = std::chrono::duration<double>(clock_type::now() - begin).count();
+  btree_alloc_stats after = btree_alloc::snapshot();
+  sink = acc;
+
+  cout << trace.size() << " operations in " << std::fixed
+       << std::setprecision(3) << seconds << " s, "
+       << std::setprecision(0) << trace.size() / seconds << " ops/s" << endl
+       << endl;
+  cout << std::left << std::setw(14) << "op (ns)" << std::right
+       << std::setw(10) << "count" << std::setw(10) << "p50"
+       << std::setw(10) << "p90" << std::setw(10) << "p99"
+       << std::setw(10) << "p99.9" << std::setw(12) << "max" << endl;
+  for (std::size_t i = 0; i < kOpKinds; ++i) report(kOpNames[i], latency[i]);
+
+  if (btree_alloc::counting && after.allocations != before.allocations) {
+    cout << endl << after.allocations - before.allocations
+         << " btree allocations (" << std::setprecision(3)
+         << static_cast<double>(after.allocations - before.allocations) / trace.size()
+         << " per op), " << after.bytes_allocated - before.bytes_allocated
+         << " bytes, peak " << after.peak_bytes - before.live_bytes
+         << " live bytes" << endl;
+  }
+}
+
+template <typename T>
+void run(std::istream &is, const string &engineName, const config &conf) {
+  btree_trace::reader<T> reader(is);
+  vector<btree_trace::record<T>> trace;
+  btree_trace::record<T> rec;
+  while (reader.next(rec)) trace.push_back(rec);
+
+  if (engineName == "btree") replay<btree<T>>(trace, conf);
+  else if (engineName == "set") replay<std::set<T>>(trace, conf);
+  else if (engineName == "unordered_set") replay<std::unordered_set<T>>(trace, conf);
+  else throw std::invalid_argument("unknown engine: " + engineName);
+}
+
+}  // namespace close
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " trace [engine] [node-size]" << endl;
+    return 1;
+  }
+  string engineName = argc > 2 ? argv[2] : "btree";
+  config conf;
+  if (argc > 3) conf.nodeSize = std::strtoul(argv[3], nullptr, 10);
+
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in) {
+    std::cerr << "cannot open " << argv[1] << endl;
+    return 1;
+  }
+
+  try {
+    string base = parse(engineName, conf);
+    cout << "replaying " << argv[1] << " on " << engineName;
+    if (base == "btree") cout << " (node size " << conf.nodeSize << ")";
+    cout << endl;
+
+    if (btree_trace::read_header(in) == btree_trace::key_kind::integer) {
+      in.seekg(0);
+      run<long>(in, base, conf);
+    } else {
+      in.seekg(0);
+      run<string>(in, base, conf);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,226 @@
+/**
+ * Operation traces for the B-Tree.
+ *
+ * A btree can be pointed at a btree_trace::writer, after which every
+ * insert, find and start of a traversal made on it is appended to a
+ * compact binary trace.  A btree_trace::reader reads such a trace back,
+ * so the same sequence of operations can be replayed against another
+ * configuration (see btree_replay.cpp).
+ *
+ * Format: the magic bytes "BTRC", a version byte and a key kind byte,
+ * then one record per operation.  A record is an opcode byte, followed
+ * for inserts and finds by the key.  Integer keys are stored as the
+ * zigzag varint of their difference from the previous key, so local
+ * access patterns cost a byte or two per key; string keys are stored as
+ * a varint length and the raw bytes.
+ */
+
+#ifndef BTREE_TRACE_H
+#define BTREE_TRACE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace btree_trace {
+
+enum class op : unsigned char { insert, find, scan, reverse_scan };
+
+enum class key_kind : unsigned char { integer, string };
+
+template <typename T>
+struct record {
+	btree_trace::op op;
+	T key;
+};
+
+namespace detail {
+
+const char kMagic[4] = {'B', 'T', 'R', 'C'};
+const unsigned char kVersion = 1;
+
+inline void put_varint(std::ostream &os, std::uint64_t v) {
+	while(v >= 0x80){
+		os.put(static_cast<char>((v & 0x7F) | 0x80));
+		v >>= 7;
+	}
+	os.put(static_cast<char>(v));
+}
+
+inline bool get_varint(std::istream &is, std::uint64_t &v) {
+	v = 0;
+	for(int shift = 0; shift < 64; shift += 7){
+		int c = is.get();
+		if(c == std::char_traits<char>::eof()) return false;
+		v |= static_cast<std::uint64_t>(c & 0x7F) << shift;
+		if(!(c & 0x80)) return true;
+	}
+	return false;
+}
+
+/**
+ * Encodes keys of type T.  Only integral types and std::string can be
+ * traced; the primary template exists so a btree of any other type still
+ * compiles, but a writer or reader for it does not.
+ */
+template <typename T, typename Enable = void>
+struct codec {
+	static const bool supported = false;
+	static const key_kind kind = key_kind::integer;
+
+	void write(std::ostream &, const T &) { }
+	bool read(std::istream &, T &) { return false; }
+};
+
+template <typename T>
+struct codec<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+	static const bool supported = true;
+	static const key_kind kind = key_kind::integer;
+
+	void write(std::ostream &os, const T &key) {
+		// differences wrap modulo 2^64, so every key round trips
+		std::uint64_t delta = static_cast<std::uint64_t>(key) - prev_;
+		prev_ = static_cast<std::uint64_t>(key);
+		put_varint(os, (delta << 1) ^ static_cast<std::uint64_t>(static_cast<std::int64_t>(delta) >> 63));
+	}
+
+	bool read(std::istream &is, T &key) {
+		std::uint64_t zz;
+		if(!get_varint(is, zz)) return false;
+		prev_ += (zz >> 1) ^ (~(zz & 1) + 1);
+		key = static_cast<T>(prev_);
+		return true;
+	}
+
+	std::uint64_t prev_ = 0;
+};
+
+template <>
+struct codec<std::string> {
+	static const bool supported = true;
+	static const key_kind kind = key_kind::string;
+
+	void write(std::ostream &os, const std::string &key) {
+		put_varint(os, key.size());
+		os.write(key.data(), key.size());
+	}
+
+	bool read(std::istream &is, std::string &key) {
+		std::uint64_t size;
+		if(!get_varint(is, size)) return false;
+		key.resize(size);
+		return static_cast<bool>(is.read(&key[0], size));
+	}
+};
+
+}
+
+/**
+ * Reads the header of a trace and returns the kind of key it holds,
+ * leaving the stream positioned at the first record.
+ *
+ * @throw std::runtime_error if the stream does not hold a trace
+ */
+inline key_kind read_header(std::istream &is) {
+	char magic[4];
+	if(!is.read(magic, 4) || !std::equal(magic, magic + 4, detail::kMagic)){
+		throw std::runtime_error("not a btree trace");
+	}
+	int version = is.get();
+	int kind = is.get();
+	if(version != detail::kVersion){
+		throw std::runtime_error("unsupported btree trace version");
+	}
+	if(kind != static_cast<int>(key_kind::integer) && kind != static_cast<int>(key_kind::string)){
+		throw std::runtime_error("unknown key kind in btree trace");
+	}
+	return static_cast<key_kind>(kind);
+}
+
+/**
+ * Appends operations on a btree<T> to an output stream.  The stream
+ * must stay open for as long as the writer is in use.
+ */
+template <typename T>
+class writer {
+	public:
+		explicit writer(std::ostream &os) : os_(os), records_{0} {
+			static_assert(detail::codec<T>::supported, "only integral and std::string keys can be traced");
+			os_.write(detail::kMagic, 4);
+			os_.put(static_cast<char>(detail::kVersion));
+			os_.put(static_cast<char>(detail::codec<T>::kind));
+		}
+
+		void insert(const T &key) { put(op::insert, key); }
+		void find(const T &key) { put(op::find, key); }
+		void scan() { put(op::scan); }
+		void reverse_scan() { put(op::reverse_scan); }
+
+		std::size_t records() const { return records_; }
+
+	private:
+		void put(op code) {
+			os_.put(static_cast<char>(code));
+			++records_;
+		}
+
+		void put(op code, const T &key) {
+			put(code);
+			codec_.write(os_, key);
+		}
+
+		std::ostream &os_;
+		detail::codec<T> codec_;
+		std::size_t records_;
+};
+
+/**
+ * Reads back a trace written by a writer<T>.
+ */
+template <typename T>
+class reader {
+	public:
+		/**
+		 * @throw std::runtime_error if the stream does not hold a trace
+		 *        of keys of type T
+		 */
+		explicit reader(std::istream &is) : is_(is) {
+			static_assert(detail::codec<T>::supported, "only integral and std::string keys can be traced");
+			if(read_header(is_) != detail::codec<T>::kind){
+				throw std::runtime_error("btree trace holds a different key type");
+			}
+		}
+
+		/**
+		 * Reads the next record.
+		 *
+		 * @return false once the trace is exhausted
+		 * @throw std::runtime_error if the trace is corrupt
+		 */
+		bool next(record<T> &rec) {
+			int code = is_.get();
+			if(code == std::char_traits<char>::eof()) return false;
+			if(code > static_cast<int>(op::reverse_scan)){
+				throw std::runtime_error("corrupt btree trace");
+			}
+			rec.op = static_cast<op>(code);
+			if(rec.op == op::insert || rec.op == op::find){
+				if(!codec_.read(is_, rec.key)){
+					throw std::runtime_error("truncated btree trace");
+				}
+			}
+			return true;
+		}
+
+	private:
+		std::istream &is_;
+		detail::codec<T> codec_;
+};
+
+}
+
+#endif
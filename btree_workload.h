@@ -0,0 +1,323 @@
+/**
+ * Deterministic workload generators for exercising the B-Tree.
+ *
+ * A key_generator produces an endless stream of integer keys drawn from
+ * one of several distributions (uniform, Zipfian, sequential, reverse
+ * sorted, clustered or hot-set) over an inclusive key range, and an
+ * op_generator turns such a stream into a mix of inserts and finds.
+ *
+ * Everything is driven by a small seedable xoshiro256** generator, and
+ * bounded and real-valued draws are derived from it directly rather than
+ * through <random>'s distributions, so a given seed produces the same
+ * stream on every platform and standard library.
+ */
+
+#ifndef BTREE_WORKLOAD_H
+#define BTREE_WORKLOAD_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace workload {
+
+/**
+ * xoshiro256** seeded through splitmix64.  Small, fast and good enough
+ * for generating benchmark and test keys.
+ */
+class rng {
+	public:
+		explicit rng(std::uint64_t seed = 1) {
+			for(auto &word : state_){
+				seed += 0x9E3779B97F4A7C15ull;
+				std::uint64_t z = seed;
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+				word = z ^ (z >> 31);
+			}
+		}
+
+		std::uint64_t next() {
+			const std::uint64_t result = rotl(state_[1] * 5, 7) * 9;
+			const std::uint64_t t = state_[1] << 17;
+			state_[2] ^= state_[0];
+			state_[3] ^= state_[1];
+			state_[1] ^= state_[2];
+			state_[0] ^= state_[3];
+			state_[2] ^= t;
+			state_[3] = rotl(state_[3], 45);
+			return result;
+		}
+
+		/**
+		 * Unbiased draw from [0, bound) using rejection on the low bits.
+		 */
+		std::uint64_t below(std::uint64_t bound) {
+			if(bound == 0) return next();
+			const std::uint64_t threshold = -bound % bound;
+			for(;;){
+				std::uint64_t r = next();
+				if(r >= threshold) return r % bound;
+			}
+		}
+
+		/**
+		 * Uniform draw from [0, 1) with 53 bits of precision.
+		 */
+		double unit() {
+			return (next() >> 11) * (1.0 / 9007199254740992.0);
+		}
+
+	private:
+		static std::uint64_t rotl(std::uint64_t x, int k) {
+			return (x << k) | (x >> (64 - k));
+		}
+
+		std::uint64_t state_[4];
+};
+
+/**
+ * Zipfian ranks in [1, n] with the given exponent, sampled by
+ * rejection-inversion (Hormann and Derflinger), so setup is O(1)
+ * whatever the size of the key range.
+ */
+class zipf_sampler {
+	public:
+		zipf_sampler(std::uint64_t n, double exponent)
+			: n_{static_cast<double>(n)}, s_{exponent} {
+			if(n == 0 || exponent <= 0){
+				throw std::invalid_argument("zipf_sampler needs n > 0 and exponent > 0");
+			}
+			hx1_ = hIntegral(1.5) - 1.0;
+			hn_ = hIntegral(n_ + 0.5);
+			sVal_ = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+		}
+
+		std::uint64_t operator()(rng &r) const {
+			for(;;){
+				double u = hn_ + r.unit() * (hx1_ - hn_);
+				double x = hIntegralInverse(u);
+				double k = std::floor(x + 0.5);
+				if(k < 1) k = 1;
+				else if(k > n_) k = n_;
+				if(k - x <= sVal_ || u >= hIntegral(k + 0.5) - h(k)){
+					return static_cast<std::uint64_t>(k);
+				}
+			}
+		}
+
+	private:
+		double h(double x) const { return std::exp(-s_ * std::log(x)); }
+
+		double hIntegral(double x) const {
+			double logX = std::log(x);
+			return helper2((1.0 - s_) * logX) * logX;
+		}
+
+		double hIntegralInverse(double x) const {
+			double t = x * (1.0 - s_);
+			if(t < -1.0) t = -1.0;
+			return std::exp(helper1(t) * x);
+		}
+
+		// log1p(x) / x and expm1(x) / x, stable around zero
+		static double helper1(double x) {
+			return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+		}
+
+		static double helper2(double x) {
+			return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+		}
+
+		double n_, s_;
+		double hx1_, hn_, sVal_;
+};
+
+enum class distribution { uniform, zipfian, sequential, reverse, clustered, hotset };
+
+/**
+ * Tuning knobs for the distributions that have any.  The defaults match
+ * the conventional YCSB settings where there is one.
+ */
+struct key_params {
+	double zipf_exponent = 0.99;     // Zipfian skew
+	std::size_t clusters = 16;       // clustered: number of clusters
+	double cluster_width = 0.001;    // clustered: width as a fraction of the range
+	double hot_fraction = 0.01;      // hotset: fraction of the range that is hot
+	double hot_probability = 0.9;    // hotset: fraction of draws that hit it
+};
+
+/**
+ * An endless, deterministic stream of keys in [low, high].
+ *
+ * Zipfian and hot-set keys are scattered across the range by a fixed
+ * permutation, so the popular keys are not simply the smallest ones.
+ * Sequential and reverse streams wrap around once the range is exhausted.
+ */
+class key_generator {
+	public:
+		key_generator(distribution dist, long low, long high, std::uint64_t seed = 1, key_params params = key_params())
+			: dist_{dist}, low_{low}, span_{static_cast<std::uint64_t>(high - low) + 1}, params_(params),
+			  rng_{seed}, zipf_{span_, params.zipf_exponent}, step_{0} {
+			if(high < low){
+				throw std::invalid_argument("key_generator needs low <= high");
+			}
+			multiplier_ = 0x9E3779B97F4A7C15ull % span_;
+			while(gcd(multiplier_, span_) != 1) ++multiplier_;
+			if(dist_ == distribution::clustered){
+				if(params_.clusters == 0){
+					throw std::invalid_argument("key_generator needs at least one cluster");
+				}
+				for(std::size_t i = 0; i < params_.clusters; ++i){
+					centres_.push_back(rng_.below(span_));
+				}
+			}
+		}
+
+		long operator()() {
+			switch(dist_){
+				case distribution::uniform:
+					return at(rng_.below(span_));
+				case distribution::zipfian:
+					return at(scatter(zipf_(rng_) - 1));
+				case distribution::sequential:
+					return at(step_++ % span_);
+				case distribution::reverse:
+					return at(span_ - 1 - step_++ % span_);
+				case distribution::clustered: {
+					std::uint64_t width = static_cast<std::uint64_t>(span_ * params_.cluster_width) + 1;
+					std::uint64_t centre = centres_[rng_.below(centres_.size())];
+					return at((centre + rng_.below(width)) % span_);
+				}
+				case distribution::hotset: {
+					std::uint64_t hot = static_cast<std::uint64_t>(span_ * params_.hot_fraction) + 1;
+					if(hot >= span_ || rng_.unit() < params_.hot_probability){
+						return at(scatter(rng_.below(hot < span_ ? hot : span_)));
+					}
+					return at(scatter(hot + rng_.below(span_ - hot)));
+				}
+			}
+			return low_;
+		}
+
+		/**
+		 * The next n keys of the stream.
+		 */
+		std::vector<long> take(std::size_t n) {
+			std::vector<long> keys;
+			keys.reserve(n);
+			while(n--) keys.push_back((*this)());
+			return keys;
+		}
+
+	private:
+		long at(std::uint64_t offset) const {
+			return low_ + static_cast<long>(offset);
+		}
+
+		/**
+		 * A bijection on [0, span) built from an affine map with a
+		 * multiplier coprime to the span.
+		 */
+		std::uint64_t scatter(std::uint64_t i) const {
+			return static_cast<std::uint64_t>((static_cast<unsigned __int128>(multiplier_) * i + span_ / 3) % span_);
+		}
+
+		static std::uint64_t gcd(std::uint64_t a, std::uint64_t b) {
+			while(b){
+				std::uint64_t t = a % b;
+				a = b;
+				b = t;
+			}
+			return a;
+		}
+
+		distribution dist_;
+		long low_;
+		std::uint64_t span_;
+		key_params params_;
+		rng rng_;
+		zipf_sampler zipf_;
+		std::uint64_t step_;
+		std::uint64_t multiplier_;
+		std::vector<std::uint64_t> centres_;
+};
+
+enum class op_kind { insert, find };
+
+struct operation {
+	op_kind kind;
+	long key;
+};
+
+/**
+ * Mixes inserts and finds over a key stream.  read_ratio is the
+ * fraction of operations that are finds; both kinds draw their keys
+ * from the same stream, as YCSB does.
+ */
+class op_generator {
+	public:
+		op_generator(key_generator keys, double read_ratio, std::uint64_t seed = 1)
+			: keys_(std::move(keys)), readRatio_{read_ratio}, rng_{seed} { }
+
+		operation operator()() {
+			op_kind kind = rng_.unit() < readRatio_ ? op_kind::find : op_kind::insert;
+			return {kind, keys_()};
+		}
+
+	private:
+		key_generator keys_;
+		double readRatio_;
+		rng rng_;
+};
+
+/**
+ * Parses the name of a distribution as used on command lines.
+ */
+inline distribution parse_distribution(const std::string &name) {
+	if(name == "uniform") return distribution::uniform;
+	if(name == "zipfian") return distribution::zipfian;
+	if(name == "sequential") return distribution::sequential;
+	if(name == "reverse") return distribution::reverse;
+	if(name == "clustered") return distribution::clustered;
+	if(name == "hotset") return distribution::hotset;
+	throw std::invalid_argument("unknown distribution: " + name);
+}
+
+inline const char* to_string(distribution dist) {
+	switch(dist){
+		case distribution::uniform: return "uniform";
+		case distribution::zipfian: return "zipfian";
+		case distribution::sequential: return "sequential";
+		case distribution::reverse: return "reverse";
+		case distribution::clustered: return "clustered";
+		case distribution::hotset: return "hotset";
+	}
+	return "unknown";
+}
+
+/**
+ * Converts a non-negative integer key into the client type under test.
+ * String keys are zero padded so they sort in the same order as the
+ * integers.
+ */
+template <typename T> T make_key(long key);
+
+template <>
+inline long make_key<long>(long key) {
+	return key;
+}
+
+template <>
+inline std::string make_key<std::string>(long key) {
+	std::string digits = std::to_string(key);
+	return std::string(digits.size() < 13 ? 13 - digits.size() : 0, '0') + digits;
+}
+
+}
+
+#endif
@@ -0,0 +1,106 @@
+/**
+ * Stress test: drives the btree with every workload distribution over a
+ * range of node sizes, mirroring each operation on a std::set and
+ * checking that lookups, iteration in both directions and copies agree.
+ **/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "btree.h"
+#include "btree_workload.h"
+
+using std::cout;
+using std::endl;
+using std::set;
+using std::string;
+
+namespace {
+
+const long kLow = 0;
+const long kHigh = 10000;
+const std::size_t kOps = 4000;
+const double kReadRatio = 0.3;
+const std::size_t kNodeSizes[] = {1, 2, 3, 7, 40};
+
+const workload::distribution kDistributions[] = {
+  workload::distribution::uniform,
+  workload::distribution::zipfian,
+  workload::distribution::sequential,
+  workload::distribution::reverse,
+  workload::distribution::clustered,
+  workload::distribution::hotset,
+};
+
+/**
+ * Confirms the tree holds exactly the elements of the model, in order
+ * both ways, and that find agrees with the model on a spread of keys.
+ **/
+template <typename T>
+bool matches(const btree<T>& tree, const set<T>& model) {
+  if (!std::equal(tree.begin(), tree.end(), model.begin(), model.end()))
+    return false;
+  if (!std::equal(tree.rbegin(), tree.rend(), model.rbegin(), model.rend()))
+    return false;
+  for (long i = kLow; i <= kHigh + 1; i += 7) {
+    T key = workload::make_key<T>(i);
+    bool inTree = tree.find(key) != tree.end();
+    bool inModel = model.find(key) != model.end();
+    if (inTree != inModel) return false;
+  }
+  return true;
+}
+
+/**
+ * Replays one mix of inserts and finds against the tree and the model.
+ **/
+template <typename T>
+bool stress(workload::distribution dist, std::size_t nodeSize, std::uint64_t seed) {
+  btree<T> tree(nodeSize);
+  set<T> model;
+  workload::op_generator ops(workload::key_generator(dist, kLow, kHigh, seed),
+                             kReadRatio, seed);
+
+  for (std::size_t i = 0; i < kOps; ++i) {
+    workload::operation op = ops();
+    T key = workload::make_key<T>(op.key);
+    if (op.kind == workload::op_kind::insert) {
+      std::pair<typename btree<T>::iterator, bool> result = tree.insert(key);
+      if (result.second != model.insert(key).second) return false;
+      if (*result.first != key) return false;
+    } else {
+      auto it = tree.find(key);
+      bool inModel = model.find(key) != model.end();
+      if ((it != tree.end()) != inModel) return false;
+      if (inModel && *it != key) return false;
+    }
+  }
+  if (!matches(tree, model)) return false;
+
+  btree<T> copy = tree;
+  btree<T> assigned(nodeSize + 1);
+  assigned.insert(workload::make_key<T>(kHigh + 100));
+  assigned = tree;
+  return matches(copy, model) && matches(assigned, model);
+}
+
+}  // namespace close
+
+int main(void) {
+  for (auto dist : kDistributions) {
+    bool ok = true;
+    for (auto size : kNodeSizes) {
+      ok = ok && stress<long>(dist, size, size * 31 + 1);
+    }
+    ok = ok && stress<string>(dist, 5, 77);
+    cout << workload::to_string(dist) << (ok ? " ok" : " FAILED") << endl;
+  }
+
+  return 0;
+}
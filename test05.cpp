@@ -0,0 +1,79 @@
+/**
+ * Records the operations made on a btree into a trace, reads the trace
+ * back and checks that replaying it rebuilds the same tree.
+ **/
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "btree.h"
+#include "btree_trace.h"
+
+template <typename T>
+void replay(std::istream &is, btree<T> &tree) {
+  btree_trace::reader<T> reader(is);
+  btree_trace::record<T> rec;
+  std::size_t counts[4] = {0, 0, 0, 0};
+  while (reader.next(rec)) {
+    ++counts[static_cast<int>(rec.op)];
+    if (rec.op == btree_trace::op::insert) tree.insert(rec.key);
+  }
+  std::cout << counts[0] << " inserts, " << counts[1] << " finds, "
+            << counts[2] << " scans, " << counts[3] << " reverse scans"
+            << std::endl;
+}
+
+int main(void) {
+  std::stringstream longTrace;
+  btree_trace::writer<long> writer(longTrace);
+  btree<long> bl(3);
+  bl.trace(&writer);
+
+  for (long i : {5L, -3L, 1000000000000L, 7L, 5L, 0L, -9000000000000000000L}) {
+    bl.insert(i);
+  }
+  bl.find(7);
+  bl.find(8);
+  std::copy(bl.begin(), bl.end(), std::ostream_iterator<long>(std::cout, " "));
+  std::cout << std::endl;
+  for (auto it = bl.rbegin(); it != bl.rend(); ++it) std::cout << *it << " ";
+  std::cout << std::endl;
+
+  // the copy is not recorded
+  btree<long> untraced = bl;
+  untraced.insert(42);
+  std::cout << writer.records() << " records" << std::endl;
+
+  btree<long> rebuilt(40);
+  replay(longTrace, rebuilt);
+  std::cout << (std::equal(bl.begin(), bl.end(), rebuilt.begin(), rebuilt.end())
+                ? "long trace replays" : "long trace differs") << std::endl;
+
+  std::stringstream stringTrace;
+  btree_trace::writer<std::string> swriter(stringTrace);
+  btree<std::string> bs;
+  bs.trace(&swriter);
+  bs.insert("comp6771");
+  bs.insert("");
+  bs.insert("comp2041");
+  bs.find("comp6771");
+
+  btree<std::string> srebuilt;
+  replay(stringTrace, srebuilt);
+  std::cout << (std::equal(bs.begin(), bs.end(), srebuilt.begin(), srebuilt.end())
+                ? "string trace replays" : "string trace differs") << std::endl;
+
+  stringTrace.clear();
+  stringTrace.seekg(0);
+  try {
+    btree_trace::reader<long> wrongType(stringTrace);
+  } catch (const std::runtime_error &e) {
+    std::cout << e.what() << std::endl;
+  }
+
+  return 0;
+}
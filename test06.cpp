@@ -0,0 +1,54 @@
+/**
+ * Checks the shape reported by btree<T>::stats() on trees whose shape is
+ * known in advance.
+ **/
+
+#include <iostream>
+
+#include "btree.h"
+
+void print(const btree_stats &st) {
+  std::cout << "size " << st.size << ", nodes " << st.nodes << ", leaves "
+            << st.leaves << ", height " << st.height << std::endl;
+  std::cout << "fill " << st.min_fill << ".." << st.max_fill << ", avg "
+            << st.avg_fill << std::endl;
+  std::cout << "per level:";
+  for (size_t i = 0; i < st.height && i < btree_stats::max_levels; ++i)
+    std::cout << " " << st.nodes_per_level[i];
+  std::cout << std::endl << "leaf depths:";
+  for (size_t i = 0; i < st.height && i < btree_stats::max_levels; ++i)
+    std::cout << " " << st.leaf_depths[i];
+  std::cout << std::endl;
+}
+
+int main(void) {
+  btree<int> empty;
+  print(empty.stats());
+  std::cout << "bytes " << empty.stats().bytes() << std::endl;
+
+  // a full root of 3 with a child hanging off each of its four slots,
+  // and the rightmost child filled up with a grandchild of its own
+  btree<int> b(3);
+  for (int i : {10, 20, 30, 5, 15, 25, 35, 36, 37, 38}) b.insert(i);
+  print(b.stats());
+  std::cout << "value bytes " << b.stats().value_bytes_used << " of "
+            << b.stats().value_bytes_reserved << std::endl;
+
+  // a sorted insert degenerates into a chain deeper than the histogram
+  btree<int> chain(1);
+  for (int i = 0; i < 100; ++i) chain.insert(i);
+  btree_stats st = chain.stats();
+  std::cout << "chain height " << st.height << ", nodes at last level "
+            << st.nodes_per_level[btree_stats::max_levels - 1]
+            << ", leaves there " << st.leaf_depths[btree_stats::max_levels - 1]
+            << std::endl;
+
+  // nodes with no room still hold one element each
+  btree<int> ones(0);
+  for (int i = 0; i < 100; ++i) ones.insert(i);
+  st = ones.stats();
+  std::cout << "node size 0: fill " << st.min_fill << ".." << st.max_fill
+            << ", avg " << st.avg_fill << std::endl;
+
+  return 0;
+}
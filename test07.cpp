@@ -0,0 +1,53 @@
+/**
+ * Checks the hot-path counters compiled in by BTREE_HOT_COUNTERS against
+ * a tree whose shape is known in advance.
+ **/
+
+#ifndef BTREE_HOT_COUNTERS
+#define BTREE_HOT_COUNTERS
+#endif
+
+#include <iostream>
+
+#include "btree.h"
+
+void print(const char *what) {
+  btree_hot_counters c = btree_counters::snapshot();
+  std::cout << what << ": " << c.inserts << " inserts visiting "
+            << c.insert_visits << " nodes, " << c.finds << " finds visiting "
+            << c.find_visits << " nodes, " << c.parent_climbs
+            << " parent climbs, " << c.node_allocations << " allocations"
+            << (c.comparisons > 0 ? ", some comparisons" : "") << std::endl;
+  btree_counters::reset();
+}
+
+int main(void) {
+  // a full root of 3 with a child hanging off each of its four slots,
+  // and the rightmost child filled up with a grandchild of its own
+  btree<int> b(3);
+  for (int i : {10, 20, 30, 5, 15, 25, 35, 36, 37, 38}) b.insert(i);
+  print("build");
+
+  b.find(38);
+  b.find(10);
+  b.find(1);
+  print("find");
+
+  for (auto it = b.begin(); it != b.end(); ++it) { }
+  print("forward scan");
+
+  for (auto it = b.rbegin(); it != b.rend(); ++it) { }
+  print("reverse scan");
+
+  btree<int> copy = b;
+  print("copy");
+
+  // spares set aside by reserve count only once an insert takes them
+  btree<int> reserved(3);
+  reserved.reserve(10);
+  print("reserve");
+  for (int i : {10, 20, 30, 5, 15, 25, 35, 36, 37, 38}) reserved.insert(i);
+  print("reserved build");
+
+  return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * Registers a couple of trees with a metrics registry and renders it in
+ * the Prometheus text format.
+ **/
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "btree.h"
+
+// moving a tree leaves its registration behind and allocates nothing, so
+// containers of trees can move them when they grow
+static_assert(std::is_nothrow_move_constructible<btree<int>>::value, "btree moves must not throw");
+static_assert(std::is_nothrow_move_assignable<btree<int>>::value, "btree moves must not throw");
+
+int main(void) {
+  btree_metrics::registry registry;
+
+  btree<int> users(3);
+  users.register_metrics(registry, "users");
+  for (int i : {10, 20, 30, 5, 15, 25, 35, 36, 37, 38, 10}) users.insert(i);
+  users.find(38);
+  users.find(1);
+  const btree<int> &cusers = users;
+  cusers.find(10);
+
+  {
+    btree<std::string> words;
+    words.register_metrics(registry, "words \"quoted\"");
+    words.insert("comp6771");
+
+    try {
+      btree<int> clash;
+      clash.register_metrics(registry, "users");
+    } catch (const std::invalid_argument &e) {
+      std::cout << e.what() << std::endl;
+    }
+
+    // copies and move-constructed trees are not registered
+    btree<int> copy = users;
+    copy.insert(99);
+    btree<int> moved = std::move(copy);
+    moved.find(99);
+
+    registry.render(std::cout);
+  }
+
+  std::cout << registry.size() << " tree registered after scope" << std::endl;
+  users.unregister_metrics();
+  std::cout << registry.size() << " trees registered at the end" << std::endl;
+
+  return 0;
+}
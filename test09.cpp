@@ -0,0 +1,83 @@
+/**
+ * Puts a Bloom filter in front of a tree's finds: misses must still miss,
+ * hits must never be lost as the filter grows, and the filter must follow
+ * the contents through copies and moves.
+ **/
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "btree.h"
+
+namespace {
+
+template <typename T>
+void report(const std::string &name, const btree<T> &tree) {
+  btree_stats st = tree.stats();
+  std::cout << name << ": " << st.bloom_checks << " checks, "
+            << st.bloom_negatives + st.bloom_false_positives << " absent, "
+            << "false positives under 3% "
+            << (st.bloom_fp_rate() < 0.03 ? "yes" : "no") << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  btree<long> b(7);
+  for (long i = 0; i < 1000; i += 2) b.insert(i);
+  b.enable_bloom();
+
+  // growing well past the filter's size forces it to be rebuilt
+  for (long i = 1000; i < 20000; i += 2) b.insert(i);
+
+  std::size_t hits = 0, misses = 0;
+  for (long i = 0; i < 20000; i += 2) hits += b.contains(i);
+  for (long i = 1; i < 20000; i += 2) misses += b.find(i) == b.end();
+  std::cout << "hits " << hits << ", misses " << misses << std::endl;
+  report("after growth", b);
+
+  btree_stats st = b.stats();
+  std::cout << "bits per key " << st.bloom_bits_per_key << ", filter counted in bytes "
+            << (st.bloom_bytes > 0 && st.bytes() > st.bloom_bytes ? "yes" : "no")
+            << std::endl;
+
+  // copies carry the filter with the contents, with counts of their own
+  const btree<long> copy(b);
+  std::cout << "copy finds 19998 " << copy.contains(19998) << ", 19999 "
+            << copy.contains(19999) << std::endl;
+  report("copy", copy);
+
+  b.rebuild_bloom();
+  report("rebuilt", b);
+
+  btree<long> small(7);
+  small.enable_bloom(16);
+  small.insert(3);
+  b = small;
+  std::cout << "assigned finds 3 " << b.contains(3) << ", 4 " << b.contains(4)
+            << ", bits per key " << b.stats().bloom_bits_per_key << std::endl;
+
+  btree<long> moved(std::move(b));
+  std::cout << "moved finds 3 " << moved.contains(3) << ", bits per key "
+            << moved.stats().bloom_bits_per_key << std::endl;
+
+  moved.disable_bloom();
+  std::cout << "disabled finds 3 " << moved.contains(3) << ", checks "
+            << moved.stats().bloom_checks << std::endl;
+
+  btree<std::string> words;
+  words.enable_bloom(4);
+  for (const char *w : {"alpha", "beta", "gamma"}) words.insert(w);
+  std::cout << "words find beta " << words.contains("beta") << ", delta "
+            << words.contains("delta") << std::endl;
+
+  try {
+    words.enable_bloom(0);
+  } catch (const std::invalid_argument &e) {
+    std::cout << "rejected: " << e.what() << std::endl;
+  }
+
+  return 0;
+}
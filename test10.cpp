@@ -0,0 +1,115 @@
+/**
+ * Exercises the per-thread finger behind find and insert: sweeps over a
+ * degenerate chain should visit a node or two per lookup, and the finger
+ * must never lead a lookup astray when trees share a finger slot, are
+ * moved from or are assigned to.
+ **/
+
+#ifndef BTREE_HOT_COUNTERS
+#define BTREE_HOT_COUNTERS
+#endif
+
+#include <iostream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "btree.h"
+
+namespace {
+
+const int kChain = 2000;
+
+double visitsPerFind() {
+  btree_hot_counters c = btree_counters::snapshot();
+  btree_counters::reset();
+  return c.finds ? static_cast<double>(c.find_visits) / c.finds : 0;
+}
+
+bool allFound(const btree<int> &tree, int low, int high) {
+  for (int i = low; i < high; ++i) {
+    if (tree.find(i) == tree.end() || *tree.find(i) != i) return false;
+  }
+  return true;
+}
+
+}  // namespace close
+
+int main(void) {
+  // sorted inserts build a chain kChain / 4 nodes deep
+  btree<int> chain(4);
+  btree_counters::reset();
+  for (int i = 0; i < kChain; ++i) chain.insert(i);
+  btree_hot_counters built = btree_counters::snapshot();
+  std::cout << "chain height " << chain.stats().height
+            << ", insert visits under 2 per insert "
+            << (built.insert_visits < 2u * kChain ? "yes" : "no") << std::endl;
+
+  btree_counters::reset();
+  for (int i = 0; i < kChain; ++i) chain.find(i);
+  std::cout << "ascending sweep under 3 visits per find "
+            << (visitsPerFind() < 3 ? "yes" : "no") << std::endl;
+  for (int i = kChain - 1; i >= 0; --i) chain.find(i);
+  std::cout << "descending sweep under 3 visits per find "
+            << (visitsPerFind() < 3 ? "yes" : "no") << std::endl;
+
+  // lookups far from the finger still find everything
+  bool jumps = true;
+  for (int i = 0; i < kChain / 2; ++i) {
+    jumps = jumps && chain.find(i) != chain.end()
+        && chain.find(kChain - 1 - i) != chain.end();
+  }
+  std::cout << "alternating ends all found " << jumps
+            << ", outside found " << (chain.find(-1) != chain.end())
+            << (chain.find(kChain) != chain.end()) << std::endl;
+
+  // trees whose ids share a finger slot take turns without confusion
+  std::vector<btree<int>> trees;
+  trees.reserve(8);
+  for (int t = 0; t < 8; ++t) {
+    trees.emplace_back(3);
+    for (int i = 0; i < 50; ++i) trees.back().insert(t * 100 + i);
+  }
+  bool separate = true;
+  for (int i = 0; i < 50; ++i) {
+    for (int t = 0; t < 8; ++t) {
+      separate = separate && trees[t].find(t * 100 + i) != trees[t].end()
+          && trees[t].find(((t + 1) % 8) * 100 + i) == trees[t].end();
+    }
+  }
+  std::cout << "interleaved trees kept apart " << separate << std::endl;
+
+  // a moved-from tree refills without following its old finger
+  btree<int> source(3);
+  for (int i = 0; i < 100; ++i) source.insert(i);
+  source.find(50);
+  btree<int> target(std::move(source));
+  source.insert(500);
+  std::cout << "moved-from finds 50 " << (source.find(50) != source.end())
+            << ", 500 " << (source.find(500) != source.end())
+            << "; target finds 50 " << (target.find(50) != target.end())
+            << std::endl;
+
+  // assignment replaces the nodes the finger pointed at
+  btree<int> other(5);
+  for (int i = 1000; i < 1100; ++i) other.insert(i);
+  target.find(99);
+  target = other;
+  std::cout << "assigned finds 99 " << (target.find(99) != target.end())
+            << ", 1099 " << (target.find(1099) != target.end()) << std::endl;
+
+  // each thread keeps its own finger on a shared tree
+  std::vector<int> ok(4, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&chain, &ok, t] {
+      const btree<int> &c = chain;
+      ok[t] = allFound(c, t * kChain / 4, (t + 1) * kChain / 4);
+    });
+  }
+  for (auto &th : threads) th.join();
+  std::cout << "threads found their quarters " << ok[0] << ok[1] << ok[2]
+            << ok[3] << std::endl;
+
+  return 0;
+}
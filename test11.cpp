@@ -0,0 +1,87 @@
+/**
+ * Answers finds from the hash side-index: every element must be found at
+ * its real position even after later inserts have moved it within its
+ * node, and copies must index their own nodes.
+ **/
+
+#include <iostream>
+#include <string>
+#include <utility>
+
+#include "btree.h"
+
+namespace {
+
+// a fixed shuffle of 0..n-1, so smaller elements keep landing in front
+// of larger ones in nodes that are not yet full
+long shuffled(long i, long n) { return (i * 7919) % n; }
+
+bool allFound(const btree<long> &tree, long n) {
+  for (long i = 0; i < n; ++i) {
+    auto it = tree.find(2 * i);
+    if (it == tree.end() || *it != 2 * i) return false;
+    if (tree.contains(2 * i + 1)) return false;
+  }
+  return true;
+}
+
+}  // namespace close
+
+int main(void) {
+  const long n = 5000;
+  btree<long> b(8);
+  for (long i = 0; i < n / 2; ++i) b.insert(2 * shuffled(i, n));
+  b.enable_hash_index();
+  for (long i = n / 2; i < n; ++i) b.insert(2 * shuffled(i, n));
+
+  std::cout << "all found " << allFound(b, n) << std::endl;
+  btree_stats st = b.stats();
+  std::cout << "entries " << st.hash_index_entries << ", lookups "
+            << st.hash_index_lookups << ", some hints stale "
+            << (st.hash_index_stale_hints > 0 ? "yes" : "no")
+            << ", updates cover entries "
+            << (st.hash_index_updates >= st.hash_index_entries ? "yes" : "no")
+            << ", index counted in bytes "
+            << (st.hash_index_bytes > 0 && st.bytes() > st.hash_index_bytes
+                    ? "yes" : "no") << std::endl;
+
+  // a duplicate is caught by the index and points at the original
+  auto dup = b.insert(1234);
+  std::cout << "duplicate inserted " << dup.second << ", at " << *dup.first
+            << ", same element " << (dup.first == b.find(1234)) << std::endl;
+
+  // the iterator from the index walks the tree like any other
+  auto it = b.find(1000);
+  ++it;
+  std::cout << "after 1000 comes " << *it << std::endl;
+
+  // copies index their own nodes
+  btree<long> copy(b);
+  *copy.find(1000) = 1000;
+  std::cout << "copy all found " << allFound(copy, n) << ", own element "
+            << (&*copy.find(1000) != &*b.find(1000)) << std::endl;
+
+  btree<long> small(3);
+  small.insert(7);
+  copy = small;
+  std::cout << "assigned without an index finds 7 " << copy.contains(7)
+            << ", entries " << copy.stats().hash_index_entries << std::endl;
+
+  btree<long> moved(std::move(b));
+  std::cout << "moved all found " << allFound(moved, n) << std::endl;
+  moved.disable_hash_index();
+  std::cout << "disabled all found " << allFound(moved, n) << ", bytes "
+            << moved.stats().hash_index_bytes << std::endl;
+
+  btree<std::string> words(2);
+  words.enable_hash_index();
+  for (const char *w : {"delta", "charlie", "bravo", "alpha", "echo"}) {
+    words.insert(w);
+  }
+  std::cout << "words find alpha " << words.contains("alpha") << ", foxtrot "
+            << words.contains("foxtrot") << ", order";
+  for (const auto &w : words) std::cout << " " << w;
+  std::cout << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * Freezes trees into the Eytzinger-ordered snapshot and thaws them back:
+ * lookups, lower bounds and iteration in both directions must agree with
+ * the tree they came from, and thawing must rebuild a shallow tree from
+ * a degenerate one.
+ **/
+
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "btree.h"
+
+namespace {
+
+bool matches(const frozen_btree<int> &frozen, const std::set<int> &expected) {
+  auto it = frozen.begin();
+  for (int v : expected) {
+    if (it == frozen.end() || *it != v) return false;
+    ++it;
+  }
+  if (it != frozen.end()) return false;
+
+  auto rit = frozen.rbegin();
+  for (auto e = expected.rbegin(); e != expected.rend(); ++e, ++rit) {
+    if (rit == frozen.rend() || *rit != *e) return false;
+  }
+  if (rit != frozen.rend()) return false;
+
+  for (int q = -1; q <= 1000; ++q) {
+    auto want = expected.lower_bound(q);
+    auto got = frozen.lower_bound(q);
+    if ((want == expected.end()) != (got == frozen.end())) return false;
+    if (want != expected.end() && *want != *got) return false;
+    if (frozen.contains(q) != (expected.count(q) == 1)) return false;
+  }
+  return true;
+}
+
+}  // namespace close
+
+int main(void) {
+  // every size up to a few complete levels of the implicit tree
+  bool all = true;
+  for (int n = 0; n <= 130; ++n) {
+    btree<int> tree(3);
+    std::set<int> expected;
+    for (int i = 0; i < n; ++i) {
+      tree.insert(i * 37 % 999);
+      expected.insert(i * 37 % 999);
+    }
+    all = all && matches(tree.freeze(), expected);
+  }
+  std::cout << "sizes 0 to 130 match " << all << std::endl;
+
+  // the snapshot is independent of the tree it came from
+  btree<int> tree(4);
+  for (int i = 0; i < 500; i += 5) tree.insert(i);
+  frozen_btree<int> frozen = tree.freeze();
+  tree.insert(1);
+  std::cout << "frozen size " << frozen.size() << ", finds 1 "
+            << frozen.contains(1) << ", finds 495 " << frozen.contains(495)
+            << ", lower bound of 496 is end "
+            << (frozen.lower_bound(496) == frozen.end()) << std::endl;
+  auto it = frozen.find(250);
+  --it;
+  std::cout << "before 250 comes " << *it << ", first " << *frozen.begin()
+            << ", last " << *--frozen.end() << std::endl;
+
+  // sorted inserts make a chain; thawing makes it shallow
+  btree<int> chain(4);
+  for (int i = 0; i < 1000; ++i) chain.insert(i);
+  btree<int> thawed = chain.freeze().thaw(4);
+  btree_stats before = chain.stats(), after = thawed.stats();
+  std::cout << "chain height " << before.height << ", thawed height "
+            << after.height << ", thawed nodes " << after.nodes
+            << ", thawed size " << after.size << std::endl;
+  bool same = true;
+  auto t = thawed.begin();
+  for (auto c = chain.begin(); c != chain.end(); ++c, ++t) same = same && *c == *t;
+  std::cout << "thawed in order " << same << std::endl;
+
+  // nodes with no room hold one element each
+  btree<int> ones = chain.freeze().thaw(0);
+  std::cout << "thawed with node size 0: size " << ones.stats().size
+            << ", finds 999 " << ones.contains(999) << std::endl;
+
+  btree<std::string> words;
+  for (const char *w : {"kiwi", "apple", "mango", "fig", "banana"}) words.insert(w);
+  frozen_btree<std::string> frozenWords = words.freeze();
+  std::cout << "words:";
+  for (const auto &w : frozenWords) std::cout << " " << w;
+  std::cout << "; lower bound of c is " << *frozenWords.lower_bound("c")
+            << ", thawed " << frozenWords.thaw() << std::endl;
+
+  frozen_btree<int> empty;
+  std::cout << "empty begins at end " << (empty.begin() == empty.end())
+            << ", thaws empty " << empty.thaw().stats().size << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * Builds learned indexes over the contents of trees filled from each
+ * workload distribution and checks every lookup against the tree.
+ **/
+
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "btree.h"
+#include "btree_learned.h"
+#include "btree_workload.h"
+
+namespace {
+
+bool agrees(const btree<long> &tree, const learned_index<long> &index) {
+  auto t = tree.begin();
+  for (auto i = index.begin(); i != index.end(); ++i, ++t) {
+    if (t == tree.end() || *i != *t) return false;
+  }
+  for (long k : tree) {
+    if (!index.contains(k) || index.contains(k + 1)) return false;
+    auto next = index.lower_bound(k + 1);
+    auto want = tree.find(k);
+    ++want;
+    if ((next == index.end()) != (want == tree.end())) return false;
+    if (next != index.end() && *next != *want) return false;
+  }
+  return index.lower_bound(std::numeric_limits<long>::min()) == index.begin()
+      && index.lower_bound(std::numeric_limits<long>::max()) == index.end();
+}
+
+}  // namespace close
+
+int main(void) {
+  const workload::distribution dists[] = {
+      workload::distribution::uniform, workload::distribution::zipfian,
+      workload::distribution::sequential, workload::distribution::reverse,
+      workload::distribution::clustered, workload::distribution::hotset};
+
+  for (auto dist : dists) {
+    btree<long> tree;
+    workload::key_generator gen(dist, 0, (1L << 40) - 1, 6771);
+    for (long k : gen.take(20000)) tree.insert(2 * k);
+
+    bool all = true;
+    for (size_t eps : {0, 4, 32}) {
+      learned_index<long> index(tree.begin(), tree.end(), eps);
+      all = all && agrees(tree, index);
+    }
+    learned_index<long> index(tree.begin(), tree.end());
+    std::cout << workload::to_string(dist) << ": agrees " << all
+              << ", model under 1% of keys "
+              << (index.model_bytes() * 100 < index.bytes() ? "yes" : "no")
+              << std::endl;
+  }
+
+  // consecutive keys fit one line exactly, whatever epsilon is
+  std::vector<int> run;
+  for (int i = -500; i < 500; ++i) run.push_back(i);
+  learned_index<int> line(run.begin(), run.end(), 0);
+  std::cout << "consecutive: " << line.segments() << " segment, finds -500 "
+            << line.contains(-500) << ", 499 " << line.contains(499)
+            << ", 500 " << line.contains(500) << std::endl;
+
+  // keys spread over the whole unsigned range
+  std::vector<unsigned long> wide = {0, 1, 1UL << 63, ~0UL - 1, ~0UL};
+  learned_index<unsigned long> spread(wide.begin(), wide.end(), 0);
+  std::cout << "wide: finds top " << spread.contains(~0UL) << ", middle "
+            << spread.contains(1UL << 63) << ", 2 " << spread.contains(2)
+            << ", after 1 comes the middle " << (*spread.lower_bound(2) == 1UL << 63)
+            << std::endl;
+
+  learned_index<long> empty;
+  std::cout << "empty: " << empty.size() << " keys, finds 0 "
+            << empty.contains(0) << std::endl;
+
+  return 0;
+}
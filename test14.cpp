@@ -0,0 +1,82 @@
+/**
+ * Encodes tree contents as a bitmap set: dense ranges must shrink to
+ * bitmaps or runs, and membership, rank, lower bounds and iteration must
+ * agree with the tree.
+ **/
+
+#include <iostream>
+#include <vector>
+
+#include "btree.h"
+#include "btree_bitmap.h"
+
+namespace {
+
+template <typename K>
+bool agrees(const btree<K> &tree, const bitmap_set<K> &set, K low, K high) {
+  auto s = set.begin();
+  for (K k : tree) {
+    if (s == set.end() || *s != k) return false;
+    ++s;
+  }
+  if (s != set.end()) return false;
+
+  size_t rank = 0;
+  auto t = tree.begin();
+  for (K q = low; q < high; ++q) {
+    while (t != tree.end() && *t < q) {
+      ++t;
+      ++rank;
+    }
+    if (set.rank(q) != rank) return false;
+    if (set.contains(q) != (tree.find(q) != tree.end())) return false;
+    auto lb = set.lower_bound(q);
+    if ((lb == set.end()) != (t == tree.end())) return false;
+    if (lb != set.end() && *lb != *t) return false;
+  }
+  return true;
+}
+
+template <typename K>
+void describe(const char *name, const btree<K> &tree, const bitmap_set<K> &set) {
+  std::cout << name << ": " << set.size() << " keys, "
+            << set.chunks(bitmap_set<K>::array) << " array "
+            << set.chunks(bitmap_set<K>::bitmap) << " bitmap "
+            << set.chunks(bitmap_set<K>::runs) << " run chunks, "
+            << set.bytes() << " bytes against " << tree.stats().bytes()
+            << " in the tree" << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  // test01's range, every key present: a single run
+  btree<long> full;
+  for (long i = 100; i < 10000; ++i) full.insert(i);
+  bitmap_set<long> fullSet(full.begin(), full.end());
+  describe("100 to 10000", full, fullSet);
+  std::cout << "agrees " << agrees(full, fullSet, 0L, 10100L) << std::endl;
+
+  // every third key over two chunks: bitmaps
+  btree<long> thirds;
+  for (long i = 0; i < 131072; i += 3) thirds.insert(i);
+  bitmap_set<long> thirdsSet(thirds.begin(), thirds.end());
+  describe("every third", thirds, thirdsSet);
+  std::cout << "agrees " << agrees(thirds, thirdsSet, -10L, 131100L)
+            << ", rank of 65536 " << thirdsSet.rank(65536) << std::endl;
+
+  // scattered keys either side of zero: arrays, ordered across the sign
+  btree<int> scattered;
+  for (int i = -50; i < 50; ++i) scattered.insert(i * 1009);
+  bitmap_set<int> scatteredSet(scattered.begin(), scattered.end());
+  describe("scattered", scattered, scatteredSet);
+  std::cout << "agrees " << agrees(scattered, scatteredSet, -60000, 60000)
+            << ", first " << *scatteredSet.begin() << std::endl;
+
+  bitmap_set<long> empty;
+  std::cout << "empty: begins at end " << (empty.begin() == empty.end())
+            << ", rank " << empty.rank(5) << ", finds 5 " << empty.contains(5)
+            << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * Packs tree contents into frame-of-reference blocks: close keys must
+ * take the narrow widths, and lookups, lower bounds and iteration in
+ * both directions must agree with the tree.
+ **/
+
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "btree.h"
+#include "btree_packed.h"
+#include "btree_workload.h"
+
+namespace {
+
+template <typename K>
+bool agrees(const btree<K> &tree, const packed_set<K> &set) {
+  auto s = set.begin();
+  for (K k : tree) {
+    if (s == set.end() || *s != k) return false;
+    ++s;
+  }
+  if (s != set.end()) return false;
+
+  auto r = set.rbegin();
+  for (auto t = tree.rbegin(); t != tree.rend(); ++t, ++r) {
+    if (r == set.rend() || *r != *t) return false;
+  }
+  if (r != set.rend()) return false;
+
+  for (K k : tree) {
+    if (!set.contains(k)) return false;
+    if (k != std::numeric_limits<K>::max()) {
+      auto next = set.lower_bound(k + 1);
+      auto want = tree.find(k);
+      ++want;
+      if ((next == set.end()) != (want == tree.end())) return false;
+      if (next != set.end() && *next != *want) return false;
+      if (set.contains(k + 1) != (tree.find(k + 1) != tree.end())) return false;
+    }
+  }
+  return true;
+}
+
+template <typename K>
+void describe(const char *name, const btree<K> &tree, const packed_set<K> &set) {
+  std::cout << name << ": " << set.size() << " keys in "
+            << set.blocks(1) << "/" << set.blocks(2) << "/" << set.blocks(4)
+            << "/" << set.blocks(8) << " blocks of 8/16/32/64 bits, "
+            << set.bytes() << " bytes against " << tree.stats().bytes()
+            << " in the tree, agrees " << agrees(tree, set) << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  // millisecond timestamps a few apart
+  btree<long> stamps;
+  long now = 1700000000000L;
+  for (int i = 0; i < 10000; ++i) stamps.insert(now += 1 + i % 7);
+  packed_set<long> stampSet(stamps.begin(), stamps.end());
+  describe("timestamps", stamps, stampSet);
+
+  // IDs with an occasional large gap between batches
+  btree<std::int64_t> ids;
+  for (std::int64_t batch = 0; batch < 20; ++batch) {
+    for (std::int64_t i = 0; i < 300; ++i) ids.insert(batch * 1000000 + i * 100);
+  }
+  packed_set<std::int64_t> idSet(ids.begin(), ids.end());
+  describe("batched ids", ids, idSet);
+
+  // uniform keys over 40 bits need wide deltas, but still match
+  btree<long> uniform;
+  workload::key_generator gen(workload::distribution::uniform, 0, (1L << 40) - 1, 6771);
+  for (long k : gen.take(5000)) uniform.insert(k);
+  packed_set<long> uniformSet(uniform.begin(), uniform.end());
+  describe("uniform", uniform, uniformSet);
+
+  // the extremes either side of zero need all 32 bits of an int
+  btree<int> extremes;
+  for (int k : {std::numeric_limits<int>::min(), -1, 0, 1, std::numeric_limits<int>::max()}) {
+    extremes.insert(k);
+  }
+  packed_set<int> extremeSet(extremes.begin(), extremes.end());
+  describe("extremes", extremes, extremeSet);
+  std::cout << "first " << *extremeSet.begin() << ", lower bound of 2 is "
+            << *extremeSet.lower_bound(2) << std::endl;
+
+  packed_set<long> empty;
+  std::cout << "empty: begins at end " << (empty.begin() == empty.end())
+            << ", finds 5 " << empty.contains(5) << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,72 @@
+/**
+ * Checks the arena-backed node store: trees of many small nodes span
+ * many chunks, child links take 4 bytes, iterators survive moving the
+ * tree, and node sizes beyond a 16-bit slot are refused.
+ **/
+
+#include <iostream>
+#include <set>
+#include <stdexcept>
+
+#include "btree.h"
+
+namespace {
+
+bool matches(const btree<int> &tree, const std::set<int> &expected) {
+  auto it = tree.begin();
+  for (int v : expected) {
+    if (it == tree.end() || *it != v) return false;
+    ++it;
+  }
+  if (it != tree.end()) return false;
+  auto rit = tree.rbegin();
+  for (auto e = expected.rbegin(); e != expected.rend(); ++e, ++rit) {
+    if (rit == tree.rend() || *rit != *e) return false;
+  }
+  return rit == tree.rend();
+}
+
+}  // namespace close
+
+int main(void) {
+  // one element a node: a node for every element, thousands of chunks
+  btree<int> tiny(1);
+  std::set<int> expected;
+  for (int i = 0; i < 50000; ++i) {
+    int k = static_cast<int>((i * 7919L) % 100003);
+    tiny.insert(k);
+    expected.insert(k);
+  }
+  btree_stats st = tiny.stats();
+  std::cout << "tiny: " << st.nodes << " nodes, matches "
+            << matches(tiny, expected) << ", 4 bytes a child slot "
+            << (st.child_bytes_used == 4 * 2 * st.nodes) << std::endl;
+
+  // copies, including onto themselves, rebuild every link
+  btree<int> copy(tiny);
+  copy = copy;
+  std::cout << "copy matches " << matches(copy, expected) << std::endl;
+
+  // iterators point into the store, which moves with the contents
+  btree<int> from(8);
+  for (int i = 0; i < 1000; ++i) from.insert(i);
+  auto it = from.find(500);
+  btree<int> to(std::move(from));
+  ++it;
+  std::cout << "after moving, next after 500 is " << *it << ", moved from is empty "
+            << (from.begin() == from.end()) << std::endl;
+  from.insert(3);
+  std::cout << "moved from takes inserts: " << from << std::endl;
+
+  btree<int> widest(65535);
+  for (int i = 0; i < 10; ++i) widest.insert(i);
+  std::cout << "65535 a node holds " << widest.stats().size << std::endl;
+  try {
+    btree<int> tooWide(65536);
+    std::cout << "65536 a node accepted" << std::endl;
+  } catch (const std::invalid_argument &e) {
+    std::cout << "65536 a node refused: " << e.what() << std::endl;
+  }
+
+  return 0;
+}
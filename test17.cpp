@@ -0,0 +1,85 @@
+/**
+ * Builds the tree with path-carrying iterators: nodes keep no parent
+ * links, and iteration must still agree with std::set on a shallow tree
+ * and on a chain far deeper than an iterator's path holds, whether it
+ * starts from begin(), end() or an iterator returned by find.
+ **/
+
+#ifndef BTREE_PATH_ITERATORS
+#define BTREE_PATH_ITERATORS
+#endif
+
+#include <iostream>
+#include <set>
+
+#include "btree.h"
+
+namespace {
+
+bool matches(const btree<int> &tree, const std::set<int> &expected) {
+  auto it = tree.begin();
+  for (int v : expected) {
+    if (it == tree.end() || *it != v) return false;
+    ++it;
+  }
+  if (it != tree.end()) return false;
+  auto rit = tree.rbegin();
+  for (auto e = expected.rbegin(); e != expected.rend(); ++e, ++rit) {
+    if (rit == tree.rend() || *rit != *e) return false;
+  }
+  return rit == tree.rend();
+}
+
+// walks forwards and backwards from elements found in the middle
+bool walks(btree<int> &tree, const std::set<int> &expected) {
+  for (int start = 0; start < 3000; start += 37) {
+    auto e = expected.lower_bound(start);
+    if (e == expected.end()) break;
+    auto it = tree.find(*e);
+    btree<int>::const_iterator cit = it;
+    for (int step = 0; step < 50 && e != expected.end(); ++step, ++e, ++cit) {
+      if (*cit != *e) return false;
+    }
+    for (int step = 0; step < 120 && e != expected.begin(); ++step) {
+      --e;
+      --cit;
+      if (*cit != *e) return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace close
+
+int main(void) {
+  btree<int> shallow(16);
+  std::set<int> expected;
+  for (int i = 0; i < 5000; ++i) {
+    int k = static_cast<int>((i * 7919L) % 10007);
+    shallow.insert(k);
+    expected.insert(k);
+  }
+  btree_stats st = shallow.stats();
+  std::cout << "shallow: height " << st.height << ", nodes " << st.nodes
+            << ", matches " << matches(shallow, expected) << ", walks "
+            << walks(shallow, expected) << std::endl;
+
+  // sorted inserts into nodes of 2 make a chain hundreds of levels deep
+  btree<int> chain(2);
+  std::set<int> sorted;
+  for (int i = 0; i < 1000; ++i) {
+    chain.insert(i * 3);
+    sorted.insert(i * 3);
+  }
+  st = chain.stats();
+  std::cout << "chain: height " << st.height << ", leaves " << st.leaves
+            << ", size " << st.size << ", matches " << matches(chain, sorted)
+            << ", walks " << walks(chain, sorted) << std::endl;
+
+  // copies rebuild the tree without any links back up to copy
+  btree<int> copy = chain;
+  std::cout << "copy matches " << matches(copy, sorted) << ", height "
+            << copy.stats().height << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,105 @@
+/**
+ * Builds the tree with gapped nodes: elements of a node still filling
+ * sit apart, and ascending, descending and scattered inserts of strings
+ * into one large node, and into a tree of small ones, must still iterate,
+ * find, copy and print in order.  Trivially copyable keys shift and copy
+ * as blocks of bytes, and must do the same.
+ **/
+
+#ifndef BTREE_GAPPED_NODES
+#define BTREE_GAPPED_NODES
+#endif
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "btree.h"
+
+namespace {
+
+std::string key(long i) {
+  std::string s = std::to_string(i);
+  return std::string(6 - s.size(), '0') + s + " a string too long to be small";
+}
+
+bool matches(const btree<std::string> &tree, const std::set<std::string> &expected) {
+  auto it = tree.begin();
+  for (const auto &v : expected) {
+    if (it == tree.end() || *it != v) return false;
+    ++it;
+  }
+  if (it != tree.end()) return false;
+  auto rit = tree.rbegin();
+  for (auto e = expected.rbegin(); e != expected.rend(); ++e, ++rit) {
+    if (rit == tree.rend() || *rit != *e) return false;
+  }
+  if (rit != tree.rend()) return false;
+  for (const auto &v : expected) {
+    auto found = tree.find(v);
+    if (found == tree.end() || *found != v) return false;
+  }
+  return tree.find(key(999999)) == tree.end();
+}
+
+// inserts count keys in the given order, checking each lands in place
+template <typename Order>
+void fill(const char *name, size_t nodeSize, long count, Order order) {
+  btree<std::string> tree(nodeSize);
+  std::set<std::string> expected;
+  bool placed = true;
+  for (long i = 0; i < count; ++i) {
+    std::string k = key(order(i));
+    auto result = tree.insert(k);
+    placed = placed && result.second && *result.first == k;
+    expected.insert(k);
+  }
+  bool again = !tree.insert(key(order(0))).second;
+
+  btree<std::string> copy(tree);
+  std::ostringstream printed, sorted;
+  printed << copy;
+  for (const auto &v : expected) sorted << v << " ";
+
+  btree_stats st = tree.stats();
+  std::cout << name << ": nodes " << st.nodes << ", placed " << placed
+            << ", rejects a repeat " << again << ", matches "
+            << matches(tree, expected) << ", copy matches "
+            << matches(copy, expected);
+  if (st.nodes == 1) std::cout << ", prints in order " << (printed.str() == sorted.str());
+  std::cout << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  // one node of 500, filled every way
+  fill("ascending", 500, 500, [](long i) { return i; });
+  fill("descending", 500, 500, [](long i) { return 500 - i; });
+  fill("scattered", 500, 500, [](long i) { return (i * 7919) % 503; });
+  fill("half full", 500, 250, [](long i) { return (i * 7919) % 503; });
+
+  // a tree of small nodes, whose leaves are still filling
+  fill("small nodes", 8, 3000, [](long i) { return (i * 7919) % 10007; });
+  fill("one a node", 1, 300, [](long i) { return (i * 7919) % 307; });
+
+  // longs, shifted by memmove and copied by memcpy, gaps and all
+  btree<long> longs(300);
+  std::set<long> expected;
+  for (long i = 0; i < 400; ++i) {
+    long k = i < 150 ? 1000 - i : (i * 7919) % 1009;
+    longs.insert(k);
+    expected.insert(k);
+  }
+  btree<long> copied;
+  copied = longs;
+  btree_stats st = copied.stats();
+  bool same = st.size == expected.size() &&
+              std::equal(expected.begin(), expected.end(), copied.begin()) &&
+              std::equal(expected.rbegin(), expected.rend(), copied.rbegin());
+  std::cout << "longs: nodes " << st.nodes << ", copy matches " << same << std::endl;
+
+  return 0;
+}
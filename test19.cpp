@@ -0,0 +1,74 @@
+/**
+ * Nodes start small and grow through size classes as they fill: a sparse
+ * tree must reserve far less than its nodes' full capacity, a tree whose
+ * nodes all fill must end with every node full, and both must still
+ * hold their elements in order.
+ **/
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+#include "btree.h"
+
+namespace {
+
+void describe(const char *name, const btree<long> &tree, const std::set<long> &expected) {
+  btree_stats st = tree.stats();
+  bool ordered = st.size == expected.size() &&
+                 std::equal(expected.begin(), expected.end(), tree.begin());
+  std::cout << name << ": nodes " << st.nodes << " (" << st.nodes_per_class[0]
+            << " small, " << st.nodes_per_class[1] << " medium, "
+            << st.nodes_per_class[2] << " full), value bytes "
+            << st.value_bytes_used << " of " << st.value_bytes_reserved
+            << ", saved " << st.capacity_bytes_saved << ", ordered " << ordered
+            << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  // scattered keys leave most leaves with a handful of elements
+  btree<long> sparse(64);
+  std::set<long> sparseKeys;
+  for (long i = 0; i < 30000; ++i) {
+    long k = (i * 7919) % 100003;
+    sparse.insert(k);
+    sparseKeys.insert(k);
+  }
+  describe("sparse", sparse, sparseKeys);
+
+  // skewed: a dense run and a long thin tail
+  btree<long> skewed(64);
+  std::set<long> skewedKeys;
+  for (long i = 0; i < 3000; ++i) {
+    long k = i < 2000 ? (i * 7919) % 2003 : 10000 + (i * 7919) % 1000003;
+    skewed.insert(k);
+    skewedKeys.insert(k);
+  }
+  describe("skewed", skewed, skewedKeys);
+
+  // sorted inserts fill each node before starting the next
+  btree<long> sorted(64);
+  std::set<long> sortedKeys;
+  for (long i = 0; i < 640; ++i) {
+    sorted.insert(i);
+    sortedKeys.insert(i);
+  }
+  describe("sorted", sorted, sortedKeys);
+
+  // a copy keeps each node's class
+  btree<long> copy(sparse);
+  describe("copy of sparse", copy, sparseKeys);
+
+  // nodes of four or fewer start full
+  btree<long> tiny(4);
+  std::set<long> tinyKeys;
+  for (long i = 0; i < 100; ++i) {
+    tiny.insert((i * 37) % 101);
+    tinyKeys.insert((i * 37) % 101);
+  }
+  describe("nodes of 4", tiny, tinyKeys);
+
+  return 0;
+}
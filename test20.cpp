@@ -0,0 +1,91 @@
+/**
+ * A tree of a few elements keeps its root inline and allocates nothing:
+ * it must iterate both ways, find, reject duplicates, copy, move and
+ * print like any other, and once it outgrows the inline root it must
+ * move to the heap with its shape and order intact.
+ **/
+
+#ifndef BTREE_ALLOC_STATS
+#define BTREE_ALLOC_STATS
+#endif
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "btree.h"
+
+// the inline root moves element by element, and throws only if they do
+static_assert(std::is_nothrow_move_constructible<btree_inline<int, 4>>::value, "inline root moves must not throw");
+static_assert(std::is_nothrow_move_assignable<btree_inline<int, 4>>::value, "inline root moves must not throw");
+
+namespace {
+
+template <typename T>
+std::string contents(const btree<T> &tree) {
+  std::ostringstream out;
+  for (const auto &v : tree) out << v << " ";
+  out << "|";
+  for (auto it = tree.rbegin(); it != tree.rend(); ++it) out << " " << *it;
+  return out.str();
+}
+
+std::uint64_t allocations() { return btree_alloc::snapshot().allocations; }
+
+}  // namespace close
+
+int main(void) {
+  std::uint64_t before = allocations();
+  btree<long> small;
+  for (long i : {50, 20, 80, 10, 90, 30, 70, 40, 60, 20}) small.insert(i);
+  btree_stats st = small.stats();
+  std::cout << "small: " << contents(small) << std::endl;
+  std::cout << "allocations " << allocations() - before << ", nodes "
+            << st.nodes << ", inline " << st.inline_size << ", bytes "
+            << st.bytes() << std::endl;
+
+  auto dup = small.insert(30);
+  std::cout << "30 again inserted " << dup.second << ", at " << *dup.first
+            << ", find 70 " << *small.find(70) << ", find 75 at end "
+            << (small.find(75) == small.end()) << std::endl;
+
+  // copies and moves keep the elements inline too
+  before = allocations();
+  btree<long> copy(small);
+  btree<long> moved(std::move(copy));
+  std::cout << "copied and moved: " << contents(moved) << ", allocations "
+            << allocations() - before << ", source empty "
+            << (copy.begin() == copy.end()) << std::endl;
+
+  // the seventeenth element moves the root to the heap
+  for (long i = 1; i <= 8; ++i) small.insert(i * 10 + 5);
+  st = small.stats();
+  std::cout << "17 elements: nodes " << st.nodes << ", inline "
+            << st.inline_size << ", heap bytes " << (st.bytes() > 0)
+            << std::endl;
+  std::cout << small << std::endl;
+
+  // an inline root is never bigger than a node
+  btree<int> three(3);
+  for (int i : {10, 20, 30, 5, 15, 25, 35}) three.insert(i);
+  st = three.stats();
+  std::cout << "nodes of 3: " << three << "| nodes " << st.nodes
+            << ", height " << st.height << std::endl;
+
+  btree<std::string> words;
+  for (const char *w : {"delta", "alpha", "charlie", "bravo"}) words.insert(w);
+  std::cout << "words: " << contents(words) << ", inline "
+            << words.stats().inline_size << std::endl;
+  for (const char *w : {"echo", "foxtrot"}) words.insert(w);
+  std::cout << "words: " << contents(words) << ", inline "
+            << words.stats().inline_size << std::endl;
+
+  btree<long> empty;
+  std::cout << "empty begins at end " << (empty.begin() == empty.end())
+            << ", rbegin at rend " << (empty.rbegin() == empty.rend())
+            << ", bytes " << empty.stats().bytes() << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * A tree given a flat threshold starts as one sorted array: it must find,
+ * iterate both ways and copy like any other, and the insert that takes it
+ * past the threshold must build nodes as shallow as a thawed snapshot's,
+ * with every element still there and in order.
+ **/
+
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "btree.h"
+
+namespace {
+
+template <typename T>
+bool matches(const btree<T> &tree, const std::set<T> &expected) {
+  auto it = tree.begin();
+  for (const auto &v : expected) {
+    if (it == tree.end() || *it != v) return false;
+    ++it;
+  }
+  if (it != tree.end()) return false;
+  auto rit = tree.rbegin();
+  for (auto e = expected.rbegin(); e != expected.rend(); ++e, ++rit) {
+    if (rit == tree.rend() || *rit != *e) return false;
+  }
+  if (rit != tree.rend()) return false;
+  for (const auto &v : expected) {
+    if (tree.find(v) == tree.end() || *tree.find(v) != v) return false;
+  }
+  return true;
+}
+
+void describe(const char *name, const btree_stats &st) {
+  std::cout << name << ": size " << st.size << ", nodes " << st.nodes
+            << ", height " << st.height << ", inline " << st.inline_size
+            << ", flat " << st.flat_size << std::endl;
+}
+
+}  // namespace close
+
+int main(void) {
+  btree<long> tree(8, 300);
+  std::set<long> expected;
+  for (long i = 0; i < 300; ++i) {
+    long k = (i * 7919) % 1009;
+    tree.insert(k);
+    expected.insert(k);
+  }
+  describe("300 flat", tree.stats());
+  std::cout << "matches " << matches(tree, expected) << ", 1008 absent "
+            << (tree.find(1008) == tree.end()) << ", duplicate inserted "
+            << tree.insert(7919 % 1009).second << std::endl;
+
+  // a flat root is filled against the most it holds before moving to nodes
+  btree<long> half(40, 300);
+  for (long i = 0; i < 150; ++i) half.insert(i);
+  std::cout << "avg fill " << tree.stats().avg_fill << ", half full "
+            << half.stats().avg_fill << std::endl;
+
+  btree<long> copy(tree);
+  describe("copy", copy.stats());
+  std::cout << "copy matches " << matches(copy, expected) << std::endl;
+
+  // one more moves the array into nodes, filled from the top
+  tree.insert(1008);
+  expected.insert(1008);
+  btree_stats st = tree.stats();
+  describe("301 in nodes", st);
+  std::cout << "matches " << matches(tree, expected) << ", as shallow as a thaw "
+            << (st.height == tree.freeze().thaw(8).stats().height) << std::endl;
+  for (long i = 1009; i < 3000; ++i) {
+    tree.insert(i);
+    expected.insert(i);
+  }
+  std::cout << "grown on " << matches(tree, expected) << std::endl;
+
+  // assigning a flat tree makes the target flat again
+  tree = copy;
+  expected.erase(1008);
+  for (long i = 1009; i < 3000; ++i) expected.erase(i);
+  describe("assigned", tree.stats());
+  std::cout << "matches " << matches(tree, expected) << std::endl;
+
+  // a threshold within the inline root never reaches the heap as an array
+  btree<std::string> words(2, 3);
+  words.enable_hash_index();
+  for (const char *w : {"delta", "alpha", "charlie"}) words.insert(w);
+  describe("three words", words.stats());
+  words.insert("bravo");
+  describe("four words", words.stats());
+  std::cout << words << "| finds bravo " << words.contains("bravo")
+            << ", index entries " << words.stats().hash_index_entries
+            << std::endl;
+
+  return 0;
+}
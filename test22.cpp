@@ -0,0 +1,118 @@
+/**
+ * After reserve(n), the next n inserts must not call the allocator at
+ * all, whatever order they come in, with or without a Bloom filter and a
+ * hash index, and in a flat tree; inserts past the reserve must allocate
+ * again and be counted as exhausting it.  Every allocation in the
+ * program is counted by replacing the global operator new.
+ **/
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <set>
+
+#include "btree.h"
+
+namespace {
+
+unsigned long allocations = 0;
+
+bool matches(const btree<long> &tree, const std::set<long> &expected) {
+  auto it = tree.begin();
+  for (long v : expected) {
+    if (it == tree.end() || *it != v) return false;
+    ++it;
+  }
+  return it == tree.end();
+}
+
+// inserts n keys from next(i) and reports the allocations they made
+template <typename Next>
+void burst(const char *name, btree<long> &tree, std::set<long> &expected,
+           long from, long n, Next next) {
+  unsigned long before = allocations;
+  for (long i = from; i < from + n; ++i) tree.insert(next(i));
+  unsigned long made = allocations - before;
+  if (made > 0) made = 1;
+  for (long i = from; i < from + n; ++i) expected.insert(next(i));
+  btree_stats st = tree.stats();
+  std::cout << name << ": allocated " << made << ", exhausted "
+            << (st.reserve_exhausted > 0) << ", matches "
+            << matches(tree, expected) << std::endl;
+}
+
+}  // namespace close
+
+void* operator new(std::size_t bytes) {
+  ++allocations;
+  if (void *ptr = std::malloc(bytes ? bytes : 1)) return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+int main(void) {
+  auto scattered = [](long i) { return (i * 7919) % 100003; };
+  auto ascending = [](long i) { return 200000 + i; };
+
+  // from empty, past the inline root, in scattered order
+  btree<long> tree(16);
+  std::set<long> expected;
+  tree.reserve(5000);
+  std::cout << "reserved spares " << (tree.stats().reserve_nodes > 0)
+            << ", counted in bytes " << (tree.stats().reserve_bytes > 0)
+            << std::endl;
+  burst("scattered", tree, expected, 0, 5000, scattered);
+
+  // on top of a tree with partial nodes, ascending
+  tree.reserve(3000);
+  burst("ascending", tree, expected, 0, 3000, ascending);
+
+  // the spares cover the worst case, so a burst far longer than the
+  // reserve is needed to run them out, and then inserts allocate again
+  auto wide = [](long i) { return 1000000 + (i * 7919) % 1000003; };
+  burst("past the reserve", tree, expected, 0, 100000, wide);
+  std::cout << "spares left " << tree.stats().reserve_nodes << std::endl;
+
+  btree<long> indexed(8);
+  std::set<long> indexedKeys;
+  for (long i = 0; i < 1000; ++i) {
+    indexed.insert(scattered(i));
+    indexedKeys.insert(scattered(i));
+  }
+  indexed.enable_bloom();
+  indexed.enable_hash_index();
+  indexed.reserve(4000);
+  burst("bloom and index", indexed, indexedKeys, 1000, 4000, scattered);
+  std::cout << "finds " << indexed.contains(scattered(4500)) << " "
+            << indexed.contains(-1) << std::endl;
+
+  // a flat tree that stays flat only reserves its array
+  btree<long> flat(40, 500);
+  std::set<long> flatKeys;
+  flat.reserve(400);
+  burst("flat", flat, flatKeys, 0, 400, scattered);
+  std::cout << "flat " << flat.stats().flat_size << ", spares "
+            << flat.stats().reserve_nodes << std::endl;
+
+  // leaving the tree object keeps the index at the reserved size
+  btree<long> single(16);
+  std::set<long> singleKeys{scattered(0)};
+  single.insert(scattered(0));
+  single.enable_hash_index();
+  single.reserve(1000);
+  burst("index from one element", single, singleKeys, 1, 999, scattered);
+
+  // and the flat array at the size it would have grown to
+  btree<long> few(40, 500);
+  std::set<long> fewKeys;
+  few.reserve(20);
+  burst("inline to flat", few, fewKeys, 0, 20, scattered);
+
+  // copies get no spares
+  btree<long> copy(tree);
+  std::cout << "copy spares " << copy.stats().reserve_nodes << std::endl;
+
+  return 0;
+}
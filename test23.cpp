@@ -0,0 +1,112 @@
+/**
+ * Copy assignment between trees with nodes rewrites the target's nodes
+ * in place: refreshing a replica from a primary of the same shape must
+ * allocate nothing, a bigger primary only its extra nodes, and a smaller
+ * one none, and every assignment must leave an exact, independent copy.
+ **/
+
+#ifndef BTREE_ALLOC_STATS
+#define BTREE_ALLOC_STATS
+#endif
+
+#include <iostream>
+#include <string>
+
+#include "btree.h"
+
+namespace {
+
+std::uint64_t allocations() { return btree_alloc::snapshot().allocations; }
+
+template <typename T>
+bool same(const btree<T> &a, const btree<T> &b) {
+  auto it = b.begin();
+  for (const auto &v : a) {
+    if (it == b.end() || *it != v) return false;
+    ++it;
+  }
+  if (it != b.end()) return false;
+  btree_stats sa = a.stats(), sb = b.stats();
+  return sa.nodes == sb.nodes && sa.height == sb.height;
+}
+
+template <typename T>
+void assign(const char *name, btree<T> &replica, const btree<T> &primary) {
+  size_t nodes = replica.stats().nodes;
+  std::uint64_t before = allocations();
+  replica = primary;
+  std::cout << name << ": " << allocations() - before << " allocations for "
+            << primary.stats().nodes << " nodes over " << nodes
+            << ", same " << same(primary, replica) << std::endl;
+}
+
+std::string key(long i) {
+  return "key " + std::to_string((i * 7919) % 100003) + " long enough not to be small";
+}
+
+}  // namespace close
+
+int main(void) {
+  btree<long> primary(16), replica(16);
+  for (long i = 0; i < 5000; ++i) primary.insert((i * 7919) % 100003);
+  assign("first refresh", replica, primary);
+  assign("same shape", replica, primary);
+
+  // the primary moves on: values change in place, and the tree grows
+  for (long i = 5000; i < 6000; ++i) primary.insert((i * 7919) % 100003);
+  assign("grown primary", replica, primary);
+
+  btree<long> smaller(16);
+  for (long i = 0; i < 100; ++i) smaller.insert(i * 3);
+  assign("smaller primary", replica, smaller);
+  assign("back to the primary", replica, primary);
+
+  // the copy is independent of the primary
+  *replica.find(0) = 0;
+  primary.insert(-1);
+  std::cout << "independent " << (replica.find(-1) == replica.end())
+            << ", finds " << replica.contains(7919) << std::endl;
+
+  // a hash index is rebuilt over the rewritten nodes
+  primary.enable_hash_index();
+  assign("with an index", replica, primary);
+  std::cout << "index finds -1 " << replica.contains(-1) << ", entries "
+            << replica.stats().hash_index_entries << std::endl;
+
+  // strings are assigned over, keeping the node storage
+  btree<std::string> words(8), copy(8);
+  for (long i = 0; i < 2000; ++i) words.insert(key(i));
+  copy = words;
+  btree_alloc_stats before = btree_alloc::snapshot();
+  copy = words;
+  std::cout << "strings: " << btree_alloc::snapshot().allocations - before.allocations
+            << " node allocations, same " << same(words, copy) << std::endl;
+
+  // nodes of another size are reallocated to the new one
+  btree<long> narrow(4), wide(40);
+  for (long i = 0; i < 30; ++i) narrow.insert(i);
+  for (long i = 0; i < 200; ++i) wide.insert(i * 2);
+  wide = narrow;
+  std::cout << "narrow over wide: same " << same(narrow, wide) << ", finds 29 "
+            << wide.contains(29) << std::endl;
+  btree<long> forty(40), sixtyfour(64);
+  for (long i = 0; i < 1000; ++i) forty.insert((i * 7919) % 100003);
+  for (long i = 0; i < 3000; ++i) sixtyfour.insert(i);
+  sixtyfour = forty;
+  sixtyfour.reserve(20000);
+  for (long i = 0; i < 20000; ++i) sixtyfour.insert(100003 + i);
+  std::cout << "forty over sixty-four, then 20000 more: " << sixtyfour.stats().size
+            << " elements, finds " << sixtyfour.contains(100003 + 19999) << std::endl;
+
+  // a tree assigned to itself is unchanged, and a flat one replaces nodes
+  replica = static_cast<const btree<long>&>(replica);
+  std::cout << "self-assigned same " << same(primary, replica) << std::endl;
+  btree<long> tiny;
+  tiny.insert(5);
+  replica = tiny;
+  std::cout << "assigned a tiny tree: " << replica << "| nodes "
+            << replica.stats().nodes << ", inline " << replica.stats().inline_size
+            << std::endl;
+
+  return 0;
+}